@@ -11,10 +11,11 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	The directory expands as files are added: once all of the entries
+//	are in use, the table doubles in size, and since the directory is
+//	kept in an ordinary (extensible) file, so does the file.  An
+//	in-memory hash table maps names to entries, so lookups stay cheap
+//	no matter how many files the directory holds.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +26,15 @@
 #include "filehdr.h"
 #include "directory.h"
 
+// Hash a file name (FNV-1a), for the in-memory name lookup tables
+static unsigned int
+HashName(char *name, unsigned int hash = 2166136261u)
+{
+    for (int i = 0; i < FileNameMaxLen && name[i]; i++)
+	hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -37,10 +47,12 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    table = NULL;
+    tableSize = 0;
+    buckets = chain = NULL;
+    numBuckets = 0;
+    dirtyLow = dirtyHigh = -1;
+    Resize(size);
 }
 
 //----------------------------------------------------------------------
@@ -51,11 +63,86 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] buckets;
+    delete [] chain;
 } 
 
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Change the table to hold "size" entries.  Entries that are added
+//	start out unused; all of them have to be written back.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int size)
+{
+    DirectoryEntry *newTable = new DirectoryEntry[size];
+    int i;
+
+    for (i = 0; i < size; i++) {
+	if (i < tableSize)
+	    newTable[i] = table[i];
+	else
+	    newTable[i].inUse = FALSE;
+    }
+    delete [] table;
+    table = newTable;
+    for (i = tableSize; i < size; i++)
+	MarkDirty(i);
+    tableSize = size;
+    Rehash();
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Rebuild the hash chains over the entries in use, and the list of
+//	free entries (in increasing order, so the table fills from the front).
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    int i;
+
+    delete [] buckets;
+    delete [] chain;
+    for (numBuckets = 8; numBuckets < tableSize; numBuckets <<= 1)
+	;
+    buckets = new int[numBuckets];
+    chain = new int[tableSize + 1];
+    for (i = 0; i < numBuckets; i++)
+	buckets[i] = -1;
+    freeList = -1;
+    for (i = tableSize - 1; i >= 0; i--) {
+	if (table[i].inUse) {
+	    int b = HashName(table[i].name) & (numBuckets - 1);
+	    chain[i] = buckets[b];
+	    buckets[b] = i;
+	} else {
+	    chain[i] = freeList;
+	    freeList = i;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::MarkDirty
+// 	Remember that entry "i" has to be written back to disk.
+//----------------------------------------------------------------------
+
+void
+Directory::MarkDirty(int i)
+{
+    if (dirtyLow == -1 || i < dirtyLow)
+	dirtyLow = i;
+    if (i > dirtyHigh)
+	dirtyHigh = i;
+}
+
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The size of the
+//	table follows the length of the directory file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,12 +150,23 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    if (size != tableSize) {
+	delete [] table;
+	table = new DirectoryEntry[size];
+	tableSize = size;
+    }
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    dirtyLow = dirtyHigh = -1;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only the
+//	range of entries that changed since the last FetchFrom/WriteBack
+//	is written; the file is extended if the table has grown.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
@@ -76,7 +174,12 @@ Directory::FetchFrom(OpenFile *file)
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    if (dirtyLow == -1)
+	return;
+    (void) file->WriteAt((char *)&table[dirtyLow], 
+		(dirtyHigh - dirtyLow + 1) * sizeof(DirectoryEntry),
+		dirtyLow * sizeof(DirectoryEntry));
+    dirtyLow = dirtyHigh = -1;
 }
 
 //----------------------------------------------------------------------
@@ -90,8 +193,10 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    int b = HashName(name) & (numBuckets - 1);
+
+    for (int i = buckets[b]; i != -1; i = chain[i])
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
 }
@@ -118,9 +223,8 @@ Directory::Find(char *name)
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.  If
+//	the directory is completely full, its table is doubled first.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
@@ -132,14 +236,20 @@ Directory::Add(char *name, int newSector)
     if (FindIndex(name) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    if (freeList == -1)			// table full, make room
+	Resize(tableSize ? tableSize * 2 : NumDirEntries);
+    int i = freeList;
+    freeList = chain[i];
+    table[i].inUse = TRUE;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+
+    int b = HashName(table[i].name) & (numBuckets - 1);
+    chain[i] = buckets[b];
+    buckets[b] = i;
+    MarkDirty(i);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -153,11 +263,20 @@ Directory::Add(char *name, int newSector)
 bool
 Directory::Remove(char *name)
 { 
-    int i = FindIndex(name);
+    int b = HashName(name) & (numBuckets - 1);
+    int *link = &buckets[b];
 
-    if (i == -1)
+    while (*link != -1 && strncmp(table[*link].name, name, FileNameMaxLen))
+	link = &chain[*link];
+    if (*link == -1)
 	return FALSE; 		// name not in directory
+
+    int i = *link;
+    *link = chain[i];
     table[i].inUse = FALSE;
+    chain[i] = freeList;
+    freeList = i;
+    MarkDirty(i);
     return TRUE;	
 }
 
@@ -193,7 +312,7 @@ Directory::Print()
 	    hdr->Print();
         if(hdr->GetFileType() == DirectoryFile){
             OpenFile *openfile = new OpenFile(table[i].sector);
-            Directory *directory = new Directory(10);
+            Directory *directory = new Directory(0);
             directory->FetchFrom(openfile);
             directory->Print();
             delete directory;
@@ -203,3 +322,148 @@ Directory::Print()
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize an empty cache of path component lookups.
+//
+//	"cacheSize" is the number of lookups the cache can hold
+//----------------------------------------------------------------------
+
+NameCache::NameCache(int cacheSize)
+{
+    size = cacheSize;
+    table = new NameCacheEntry[size];
+    buckets = new int[size];
+    for (int i = 0; i < size; i++) {
+	table[i].inUse = FALSE;
+	buckets[i] = -1;
+    }
+    hand = 0;
+    hits = misses = 0;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+    delete [] table;
+    delete [] buckets;
+}
+
+int
+NameCache::Bucket(int parent, char *name)
+{
+    return HashName(name, 2166136261u ^ (unsigned int)parent) % size;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Unlink
+// 	Take slot "slot" out of its hash chain and mark it free.
+//----------------------------------------------------------------------
+
+void
+NameCache::Unlink(int slot)
+{
+    int *link = &buckets[Bucket(table[slot].parent, table[slot].name)];
+
+    while (*link != slot)
+	link = &table[*link].next;
+    *link = table[slot].next;
+    table[slot].inUse = FALSE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Lookup
+// 	Look up "name" in the directory whose header is at "parent".
+//	Return FALSE if the lookup is not cached; otherwise return TRUE,
+//	with the file's header sector (or -1 if the name does not exist)
+//	in "sector", and whether it is a directory in "isDir".
+//----------------------------------------------------------------------
+
+bool
+NameCache::Lookup(int parent, char *name, int *sector, bool *isDir)
+{
+    for (int i = buckets[Bucket(parent, name)]; i != -1; i = table[i].next)
+	if (table[i].parent == parent && 
+			!strncmp(table[i].name, name, FileNameMaxLen)) {
+	    *sector = table[i].sector;
+	    *isDir = table[i].isDir;
+	    hits++;
+	    return TRUE;
+	}
+    misses++;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember that "name" in the directory at "parent" has its header
+//	at "sector" (-1 if there is no such file).  If the cache is full,
+//	an older lookup is replaced.
+//----------------------------------------------------------------------
+
+void
+NameCache::Enter(int parent, char *name, int sector, bool isDir)
+{
+    Invalidate(parent, name);
+    int slot = hand;
+    hand = (hand + 1) % size;
+    if (table[slot].inUse)
+	Unlink(slot);
+
+    table[slot].inUse = TRUE;
+    table[slot].parent = parent;
+    table[slot].sector = sector;
+    table[slot].isDir = isDir;
+    strncpy(table[slot].name, name, FileNameMaxLen);
+    table[slot].name[FileNameMaxLen] = '\0';
+
+    int b = Bucket(parent, table[slot].name);
+    table[slot].next = buckets[b];
+    buckets[b] = slot;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Invalidate
+// 	Forget the lookup of "name" in the directory at "parent", if cached.
+//----------------------------------------------------------------------
+
+void
+NameCache::Invalidate(int parent, char *name)
+{
+    for (int i = buckets[Bucket(parent, name)]; i != -1; i = table[i].next)
+	if (table[i].parent == parent && 
+			!strncmp(table[i].name, name, FileNameMaxLen)) {
+	    Unlink(i);
+	    return;
+	}
+}
+
+//----------------------------------------------------------------------
+// NameCache::Purge
+// 	Forget every lookup made in the directory at "parent"; used when
+//	the directory is deleted, since its sector may be reused.
+//----------------------------------------------------------------------
+
+void
+NameCache::Purge(int parent)
+{
+    for (int i = 0; i < size; i++)
+	if (table[i].inUse && table[i].parent == parent)
+	    Unlink(i);
+}
+
+//----------------------------------------------------------------------
+// NameCache::Print
+// 	Print how well the cache is doing.  For debugging.
+//----------------------------------------------------------------------
+
+void
+NameCache::Print()
+{
+    printf("Name cache: %d hits, %d misses\n", hits, misses);
+}
@@ -21,6 +21,8 @@
 
 #define FileNameMaxLen 		256	// for simplicity, we assume 
 					// file names are <= 9 characters long
+#define NumDirEntries 		10	// initial size of a directory; it
+					// doubles whenever it fills up
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -47,6 +49,12 @@ class DirectoryEntry {
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
 // from/to disk. 
+//
+// The directory file is extensible: when every entry is in use, Add 
+// doubles the table, and the file grows with it on the next WriteBack.
+// Names are looked up through an in-memory hash table (rebuilt whenever
+// the entries are read from disk), so Find does not depend on how many
+// files the directory holds.
 
 class Directory {
   public:
@@ -57,11 +65,13 @@ class Directory {
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+					// (only the entries that changed)
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector);  // Add a file name into the directory,
+					// growing the table if it is full
 
     bool Remove(char *name);		// Remove a file from the directory
 
@@ -78,6 +88,69 @@ class Directory {
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+
+  private:
+    void Resize(int size);		// Change the table to "size" entries
+    void Rehash();			// Rebuild the hash chains and free list
+    void MarkDirty(int i);		// Entry "i" must be written back
+
+    int numBuckets;			// Size of the hash table (a power of 2)
+    int *buckets;			// First entry in each hash bucket, or -1
+    int *chain;				// Next entry in the same bucket (for
+					// entries in use) or on the free list
+    int freeList;			// First unused entry, or -1 if full
+    int dirtyLow, dirtyHigh;		// Range of entries changed since the
+					// last FetchFrom/WriteBack
+};
+
+// The following class caches the result of looking up one path component
+// in a directory, keyed by <sector of the directory's header, name>.
+// FileSystem::FindDir walks a path through the cache, so a path whose
+// components are all cached costs no disk I/O at all.  Names that were
+// not found are cached too (sector -1), so a miss is only paid once.
+//
+// The cache has a fixed number of slots and replaces entries round robin
+// once it is full.  The file system must invalidate an entry whenever
+// the directory changes under it (Create, Remove).
+
+#define NameCacheSize		64
+
+class NameCacheEntry {
+  public:
+    bool inUse;				// Is this slot holding a lookup?
+    int parent;				// Header sector of the directory
+    int sector;				// Header sector of the file, or -1
+					// if "name" is not in "parent"
+    bool isDir;				// Is the file a directory?
+    int next;				// Next slot in the same hash bucket
+    char name[FileNameMaxLen + 1];	// Path component that was looked up
+};
+
+class NameCache {
+  public:
+    NameCache(int cacheSize);		// Initialize an empty cache
+    ~NameCache();
+
+    bool Lookup(int parent, char *name, int *sector, bool *isDir);
+					// Return TRUE if the lookup of "name"
+					// in "parent" is cached
+    void Enter(int parent, char *name, int sector, bool isDir);
+					// Remember the result of a lookup
+    void Invalidate(int parent, char *name);	// Forget one lookup
+    void Purge(int parent);		// Forget every lookup in "parent"
+
+    void Print();			// Print the hit/miss counts
+
+    int hits, misses;			// Lookups answered/not answered
+
+  private:
+    int Bucket(int parent, char *name);	// Hash <parent, name>
+    void Unlink(int slot);		// Take a slot out of its bucket
+
+    int size;				// Number of slots
+    NameCacheEntry *table;
+    int *buckets;			// First slot in each bucket, or -1
+    int hand;				// Next slot to replace
 };
 
 #endif // DIRECTORY_H
@@ -26,15 +26,193 @@
 #include "synch.h"
 #include "system.h"
 #include "filehdr.h"
+#include "directory.h"
 
 FileHeader::FileHeader(){
-    lock = new Lock("file header lock");
+    lock = new ReadWriteLock("file header lock");
+    index[0] = index[1] = index[2] = NULL;
+    directory = NULL;
+    dirty = removed = FALSE;
+    pages = lastPage = NULL;
+    numPages = pendingBytes = reserved = 0;
+    cachedSector = -1;
+    nextClosed = NULL;
 }
 
 FileHeader::~FileHeader(){
+    while(pages != NULL){
+        FilePage *next = pages->next;
+        delete pages;
+        numPages--;
+        pages = next;
+    }
+    reservedSectors -= reserved;
+    DropIndex();
+    delete directory;
     delete lock;
 }
 
+//----------------------------------------------------------------------
+// IndexBlock::IndexBlock
+// 	Set up the in-memory copy of the index block stored in "sectorNumber".
+//	The caller either reads the entries in from disk or, for a newly 
+//	allocated block, leaves them cleared.
+//----------------------------------------------------------------------
+
+IndexBlock::IndexBlock(int sectorNumber){
+    sector = sectorNumber;
+    for(int i = 0;i < NumIndirect;i++) entries[i] = 0;
+    children = NULL;
+    dirty = FALSE;
+}
+
+IndexBlock::~IndexBlock(){
+    if(children){
+        for(int i = 0;i < NumIndirect;i++) delete children[i];
+        delete[] children;
+    }
+}
+
+//----------------------------------------------------------------------
+// FilePage::FilePage
+// 	Set up an empty buffered page for block "whichBlock" of a file.
+//----------------------------------------------------------------------
+
+FilePage::FilePage(int whichBlock){
+    block = whichBlock;
+    data = new char[FileHeader::blockSize];
+    next = NULL;
+}
+
+FilePage::~FilePage(){
+    delete [] data;
+}
+
+// An empty table of child index blocks, none of them loaded yet
+static IndexBlock **NewChildren(){
+    IndexBlock **children = new IndexBlock*[NumIndirect];
+    for(int i = 0;i < NumIndirect;i++) children[i] = NULL;
+    return children;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex
+// 	Return the cached index block whose sector number is kept in 
+//	"*sectorPtr", reading it from disk the first time.  If there is no
+//	such block yet and "freeMap" is given, a fresh (empty) index block 
+//	is allocated, and whoever points at it is marked dirty; NULL is
+//	returned if the disk is full.
+//
+//	Entries covering blocks past the end of the file are cleared when
+//	the block is read, so that 0 always means "not allocated".
+//
+//	"cache" -- where the in-memory copy is kept
+//	"first" -- the first data block of the file covered by this block
+//	"span" -- the number of data blocks covered by each entry
+//	"parent" -- the index block holding "*sectorPtr", NULL if the header
+//----------------------------------------------------------------------
+
+IndexBlock *FileHeader::LoadIndex(IndexBlock **cache, int *sectorPtr, int first,
+				  int span, BitMap *freeMap, IndexBlock *parent){
+    if(*cache) return *cache;
+    if(*sectorPtr == 0){            // 索引块尚未分配
+        if(freeMap == NULL) return NULL;
+        int sector = freeMap->Find();
+        if(sector == -1) return NULL;   // 磁盘已满
+        *sectorPtr = sector;
+        if(parent) parent->dirty = TRUE;
+        *cache = new IndexBlock(*sectorPtr);
+        (*cache)->dirty = TRUE;
+        return *cache;
+    }
+    IndexBlock *block = new IndexBlock(*sectorPtr);
+    journal->ReadSector(block->sector, (char *)block->entries);
+    if(*cache){                     // 读盘时另一个读者已经载入了
+        delete block;
+        return *cache;
+    }
+    for(int i = 0;i < NumIndirect;i++)
+        if(first + i * span >= numBlocks) block->entries[i] = 0;
+    *cache = block;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::BlockSlot
+// 	Return a pointer to the entry (in the header, or in a cached index
+//	block) that holds the disk sector of data block "block" of the file.
+//	"*owner" is set to the index block holding the entry, or NULL if it
+//	lives in the header itself.
+//
+//	If "freeMap" is NULL, nothing is allocated and NULL is returned when
+//	an index block along the way does not exist; otherwise NULL means
+//	there was no room for a missing index block.
+//----------------------------------------------------------------------
+
+int *FileHeader::BlockSlot(int block, BitMap *freeMap, IndexBlock **owner){
+    *owner = NULL;
+    if(block < NumDirect) return &dataSectors[block];    // 直接索引
+    int first = NumDirect;
+    block -= NumDirect;
+    int span = NumIndirect;
+    for(int level = 0;level < 3;level++){   // 一、二、三级索引
+        if(block < span){
+            IndexBlock **cache = &index[level];
+            int *sectorPtr = &dataSectors[NumDirect + level];
+            IndexBlock *parent = NULL;
+            while(true){
+                IndexBlock *node = LoadIndex(cache, sectorPtr, first, 
+                                             span / NumIndirect, freeMap, parent);
+                if(node == NULL) return NULL;
+                span /= NumIndirect;
+                int i = block / span;
+                block %= span;
+                if(span == 1){
+                    *owner = node;
+                    return &node->entries[i];
+                }
+                if(node->children == NULL) node->children = NewChildren();
+                first += i * span;
+                cache = &node->children[i];
+                sectorPtr = &node->entries[i];
+                parent = node;
+            }
+        }
+        first += span;
+        block -= span;
+        span *= NumIndirect;
+    }
+    ASSERT(FALSE);      // 太长
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FlushIndex
+// 	Write every dirty cached index block below "block" back to disk.
+//----------------------------------------------------------------------
+
+void FileHeader::FlushIndex(IndexBlock *block){
+    if(block == NULL) return;
+    if(block->dirty){
+        journal->WriteSector(block->sector, (char *)block->entries);
+        block->dirty = FALSE;
+    }
+    if(block->children)
+        for(int i = 0;i < NumIndirect;i++) FlushIndex(block->children[i]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DropIndex
+// 	Forget the cached index blocks (they must have been written back,
+//	or belong to a file that is going away).
+//----------------------------------------------------------------------
+
+void FileHeader::DropIndex(){
+    for(int level = 0;level < 3;level++){
+        delete index[level];
+        index[level] = NULL;
+    }
+}
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
@@ -45,168 +223,99 @@ FileHeader::~FileHeader(){
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"sparse" -- if TRUE, allocate nothing: the file is one big hole
 //----------------------------------------------------------------------
 
-bool FileHeader::Allocate(BitMap *freeMap, int fileSize, FileType fileType){
+bool FileHeader::Allocate(BitMap *freeMap, int fileSize, FileType fileType,
+			  bool sparse){
     this->fileType = fileType;
     lastModifiedTime = lastVisitedTime = createdTime = time(0);
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    int remainSectors = numSectors;
-    for(int i = 0;i < NumDirect && remainSectors;i++){      // 直接索引
-        dataSectors[i] = freeMap->Find();
-        ASSERT(dataSectors[i] != -1);
-        --remainSectors;
-    }
-    if(!remainSectors)return TRUE;    // 一级索引
-    dataSectors[NumDirect] = freeMap->Find();
-    ASSERT(dataSectors[NumDirect] != -1);
-    int *buffer1 = new int[NumIndirect];
-	for(int i = 0;i < NumIndirect && remainSectors;i++){
-        buffer1[i] = freeMap->Find();
-        ASSERT(buffer1[i] != -1);
-        --remainSectors;
-    }
-    synchDisk->WriteSector(dataSectors[NumDirect], (char *)buffer1); 
-    delete[] buffer1;
-    if(!remainSectors)return TRUE;    // 二级索引
-    dataSectors[NumDirect + 1] = freeMap->Find();
-    ASSERT(dataSectors[NumDirect + 1] != -1);
-    buffer1 = new int[NumIndirect];
-    int *buffer2 = new int[NumIndirect];
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        buffer1[i] = freeMap->Find();
-        ASSERT(buffer1[i] != -1);
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            buffer2[j] = freeMap->Find();
-            ASSERT(buffer2[j] != -1);
-            --remainSectors;
-        }
-        synchDisk->WriteSector(buffer1[i], (char *)buffer2); 
-    }
-    synchDisk->WriteSector(dataSectors[NumDirect + 1], (char *)buffer1); 
-    delete[] buffer1;
-    delete[] buffer2;
-    if(!remainSectors)return TRUE;    // 三级索引
-    dataSectors[NumDirect + 2] = freeMap->Find();
-    ASSERT(dataSectors[NumDirect + 2] != -1);
-    buffer1 = new int[NumIndirect];
-    buffer2 = new int[NumIndirect];
-    int *buffer3 = new int[NumIndirect];
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        buffer1[i] = freeMap->Find();
-        ASSERT(buffer1[i] != -1);
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            buffer2[j] = freeMap->Find();
-            ASSERT(buffer2[j] != -1);
-            for(int k = 0;k < NumIndirect && remainSectors;k++){
-                buffer3[k] = freeMap->Find();
-                ASSERT(buffer3[k] != -1);
-                --remainSectors;
-            }
-            synchDisk->WriteSector(buffer2[j], (char *)buffer3); 
-        }
-        synchDisk->WriteSector(buffer1[i], (char *)buffer2); 
-    }
-    synchDisk->WriteSector(dataSectors[NumDirect + 2], (char *)buffer1); 
-    delete[] buffer1;
-    delete[] buffer2;
-    delete[] buffer3;
-    return TRUE;
+    numBytes = numBlocks = 0;
+    for(int i = 0;i < NumDirect + 3;i++) dataSectors[i] = 0;
+    DropIndex();
+    return ExpandSize(freeMap, fileSize, sparse);
 }
 
-bool FileHeader::ExpandSize(BitMap *freeMap, int fileSize){
+//----------------------------------------------------------------------
+// FileHeader::ExpandSize
+// 	Grow the file to "fileSize" bytes, allocating data blocks (and any
+//	index blocks they need) for the new part of the file only.  The 
+//	index blocks touched are written back once, at the end.
+//
+//	If "sparse", the new part of the file is left as a hole; blocks
+//	are allocated one at a time later, by AllocateBlock, as they are
+//	written.  Otherwise, if the disk fills up, the file only grows to
+//	cover the blocks that could be allocated, and FALSE is returned.
+//----------------------------------------------------------------------
+
+bool FileHeader::ExpandSize(BitMap *freeMap, int fileSize, bool sparse){
     lastModifiedTime = lastVisitedTime = time(0);
-    int oldSectors = divRoundUp(numBytes, SectorSize);
+    dirty = TRUE;
+    int newBlocks = divRoundUp(fileSize, blockSize);
+    if(fileSize > MaxFileSize) return FALSE;
+    bool success = TRUE;
+    if(!sparse)
+        for(int i = numBlocks;i < newBlocks;i++)
+            if(AllocateBlock(i, freeMap) == -1){
+                newBlocks = i;
+                if(fileSize > i * blockSize) fileSize = i * blockSize;
+                success = FALSE;
+                break;
+            }
+    if(newBlocks > numBlocks) numBlocks = newBlocks;
     numBytes = fileSize;
-    numSectors = divRoundUp(fileSize, SectorSize);
-    int remainSectors = numSectors;
-    for(int i = 0;i < NumDirect && remainSectors;i++){      // 直接索引
-        if(!oldSectors){
-            dataSectors[i] = freeMap->Find();
-            ASSERT(dataSectors[i] != -1);
-        }else --oldSectors;
-        --remainSectors;
-    }
-    if(!remainSectors)return TRUE;    // 一级索引
-    if(!oldSectors){
-        dataSectors[NumDirect] = freeMap->Find();
-        ASSERT(dataSectors[NumDirect] != -1);
-    }
-    int *buffer1 = new int[NumIndirect];
-    synchDisk->ReadSector(dataSectors[NumDirect], (char *)buffer1); 
-	for(int i = 0;i < NumIndirect && remainSectors;i++){
-        if(!oldSectors){
-            buffer1[i] = freeMap->Find();
-            ASSERT(buffer1[i] != -1);
-        }else --oldSectors;
-        --remainSectors;
-    }
-    if(!oldSectors)synchDisk->WriteSector(dataSectors[NumDirect], (char *)buffer1); 
-    delete[] buffer1;
-    if(!remainSectors)return TRUE;    // 二级索引
-    if(!oldSectors){
-        dataSectors[NumDirect + 1] = freeMap->Find();
-        ASSERT(dataSectors[NumDirect + 1] != -1);
-    }
-    buffer1 = new int[NumIndirect];
-    int *buffer2 = new int[NumIndirect];
-    synchDisk->ReadSector(dataSectors[NumDirect + 1], (char *)buffer1); 
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        if(!oldSectors){
-            buffer1[i] = freeMap->Find();
-            ASSERT(buffer1[i] != -1);
-        }
-        synchDisk->ReadSector(buffer1[i], (char *)buffer2); 
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            if(!oldSectors){
-                buffer2[j] = freeMap->Find();
-                ASSERT(buffer2[j] != -1);
-            }else --oldSectors;
-            --remainSectors;
-        }
-        if(!oldSectors)synchDisk->WriteSector(buffer1[i], (char *)buffer2); 
+    for(int level = 0;level < 3;level++) FlushIndex(index[level]);
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateBlock
+// 	Return the disk sector holding data block "block" of the file.  If
+//	the block is a hole, allocate a sector for it first (and any index
+//	blocks on the way to it); the caller writes back the index blocks.
+//	Return -1 if there is no room left on the disk.
+//----------------------------------------------------------------------
+
+int FileHeader::AllocateBlock(int block, BitMap *freeMap){
+    IndexBlock *owner;
+    int *slot = BlockSlot(block, freeMap, &owner);
+    if(slot == NULL) return -1;
+    if(*slot == 0){
+        int sector = freeMap->FindRun(sectorsPerBlock);
+        if(sector == -1) return -1;
+        *slot = sector;
+        if(owner) owner->dirty = TRUE;
+        else dirty = TRUE;
     }
-    if(!oldSectors)synchDisk->WriteSector(dataSectors[NumDirect + 1], (char *)buffer1); 
-    delete[] buffer1;
-    delete[] buffer2;
-    if(!remainSectors)return TRUE;    // 三级索引
-    if(!oldSectors){
-        dataSectors[NumDirect + 2] = freeMap->Find();
-        ASSERT(dataSectors[NumDirect + 2] != -1);
+    return *slot;
+}
+
+// Free the sectors of the data block starting at "sector"
+static void FreeBlock(int sector, BitMap *freeMap){
+    for(int i = 0;i < FileHeader::sectorsPerBlock;i++){
+        ASSERT(freeMap->Test(sector + i));
+        freeMap->Clear(sector + i);
     }
-    buffer1 = new int[NumIndirect];
-    buffer2 = new int[NumIndirect];
-    int *buffer3 = new int[NumIndirect];
-    synchDisk->ReadSector(dataSectors[NumDirect + 2], (char *)buffer1); 
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        if(!oldSectors){
-            buffer1[i] = freeMap->Find();
-            ASSERT(buffer1[i] != -1);
-        }
-        synchDisk->ReadSector(buffer1[i], (char *)buffer2); 
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            if(!oldSectors){
-                buffer2[j] = freeMap->Find();
-                ASSERT(buffer2[j] != -1);
-            }
-            synchDisk->ReadSector(buffer2[j], (char *)buffer3); 
-            for(int k = 0;k < NumIndirect && remainSectors;k++){
-                if(!oldSectors){
-                    buffer3[k] = freeMap->Find();
-                    ASSERT(buffer3[k] != -1);
-                }else --oldSectors;
-                --remainSectors;
-            }
-            if(!oldSectors)synchDisk->WriteSector(buffer2[j], (char *)buffer3); 
-        }
-        if(!oldSectors)synchDisk->WriteSector(buffer1[i], (char *)buffer2); 
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeIndex
+// 	Free the index block "block", along with all of the blocks it 
+//	points to.  "first" and "span" are as for LoadIndex.
+//----------------------------------------------------------------------
+
+void FileHeader::FreeIndex(IndexBlock *block, int first, int span, BitMap *freeMap){
+    for(int i = 0;i < NumIndirect;i++){
+        if(block->entries[i] == 0) continue;
+        if(span > 1){
+            if(block->children == NULL) block->children = NewChildren();
+            IndexBlock *child = LoadIndex(&block->children[i], &block->entries[i],
+                                          first + i * span, span / NumIndirect, NULL, block);
+            FreeIndex(child, first + i * span, span / NumIndirect, freeMap);
+        } else FreeBlock(block->entries[i], freeMap);
     }
-    if(!oldSectors)synchDisk->WriteSector(dataSectors[NumDirect + 2], (char *)buffer1); 
-    delete[] buffer1;
-    delete[] buffer2;
-    delete[] buffer3;
-    return TRUE;
+    ASSERT(freeMap->Test(block->sector));
+    freeMap->Clear(block->sector);
 }
 
 //----------------------------------------------------------------------
@@ -217,66 +326,18 @@ bool FileHeader::ExpandSize(BitMap *freeMap, int fileSize){
 //----------------------------------------------------------------------
 
 void FileHeader::Deallocate(BitMap *freeMap){
-    int remainSectors = numSectors;
-    for(int i = 0;i < NumDirect && remainSectors;i++){      // 直接索引
-        ASSERT(freeMap->Test(dataSectors[i]));
-        freeMap->Clear(dataSectors[i]);
-        --remainSectors;
+    for(int i = 0;i < NumDirect && i < numBlocks;i++){      // 直接索引
+        if(dataSectors[i] != 0) FreeBlock(dataSectors[i], freeMap);  // 跳过空洞
     }
-    if(!remainSectors)return;    // 一级索引
-    int *buffer1 = new int[NumIndirect];
-    ASSERT(freeMap->Test(dataSectors[NumDirect]));
-    synchDisk->ReadSector(dataSectors[NumDirect], (char *)buffer1);
-	for(int i = 0;i < NumIndirect && remainSectors;i++){
-        ASSERT(freeMap->Test(buffer1[i]));
-        freeMap->Clear(buffer1[i]);
-        --remainSectors;
+    int first = NumDirect, span = NumIndirect;
+    for(int level = 0;level < 3;level++){        // 一、二、三级索引
+        IndexBlock *block = LoadIndex(&index[level], &dataSectors[NumDirect + level],
+                                      first, span / NumIndirect, NULL, NULL);
+        if(block) FreeIndex(block, first, span / NumIndirect, freeMap);
+        first += span;
+        span *= NumIndirect;
     }
-    freeMap->Clear(dataSectors[NumDirect]);
-    delete[] buffer1;
-    if(!remainSectors)return;    // 二级索引
-    buffer1 = new int[NumIndirect];
-    int *buffer2 = new int[NumIndirect];
-    ASSERT(freeMap->Test(dataSectors[NumDirect + 1]));
-    synchDisk->ReadSector(dataSectors[NumDirect + 1], (char *)buffer1);
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        ASSERT(freeMap->Test(buffer1[i]));
-        synchDisk->ReadSector(buffer1[i], (char *)buffer2);
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            ASSERT(freeMap->Test(buffer2[j]));
-            freeMap->Clear(buffer2[j]);
-            --remainSectors;
-        }
-        freeMap->Clear(buffer1[i]);
-    }
-    freeMap->Clear(dataSectors[NumDirect + 1]);
-    delete[] buffer1;
-    delete[] buffer2;
-    if(!remainSectors)return;    // 三级索引
-    buffer1 = new int[NumIndirect];
-    buffer2 = new int[NumIndirect];
-    int *buffer3 = new int[NumIndirect];
-    ASSERT(freeMap->Test(dataSectors[NumDirect + 2]));
-    synchDisk->ReadSector(dataSectors[NumDirect + 2], (char *)buffer1);
-    for(int i = 0;i < NumIndirect && remainSectors;i++){ 
-        ASSERT(freeMap->Test(buffer1[i]));
-        synchDisk->ReadSector(buffer1[i], (char *)buffer2);
-        for(int j = 0;j < NumIndirect && remainSectors;j++){
-            ASSERT(freeMap->Test(buffer2[j]));
-            synchDisk->ReadSector(buffer2[j], (char *)buffer3);
-            for(int k = 0;k < NumIndirect && remainSectors;k++){
-                ASSERT(freeMap->Test(buffer3[k]));
-                freeMap->Clear(buffer3[k]);
-                --remainSectors;
-            }
-            freeMap->Clear(buffer2[j]);
-        }
-        freeMap->Clear(buffer1[i]);
-    }
-    freeMap->Clear(dataSectors[NumDirect + 2]);
-    delete[] buffer1;
-    delete[] buffer2;
-    delete[] buffer3;
+    DropIndex();
 }
 
 //----------------------------------------------------------------------
@@ -287,8 +348,19 @@ void FileHeader::Deallocate(BitMap *freeMap){
 //----------------------------------------------------------------------
 
 void FileHeader::FetchFrom(int sector){
-    synchDisk->ReadSector(sector, (char *)this);
-    numSectors  = divRoundUp(numBytes, SectorSize);
+    journal->ReadSector(sector, (char *)this);
+    dirty = FALSE;
+    numBlocks  = divRoundUp(numBytes, blockSize);
+    DropIndex();
+    // pointers past the end of the file are not meaningful on disk;
+    // clear them so that 0 always means "not allocated"
+    for(int i = numBlocks;i < NumDirect;i++) dataSectors[i] = 0;
+    int first = NumDirect, span = NumIndirect;
+    for(int level = 0;level < 3;level++){
+        if(first >= numBlocks) dataSectors[NumDirect + level] = 0;
+        first += span;
+        span *= NumIndirect;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -299,7 +371,8 @@ void FileHeader::FetchFrom(int sector){
 //----------------------------------------------------------------------
 
 void FileHeader::WriteBack(int sector) {
-    synchDisk->WriteSector(sector, (char *)this); 
+    journal->WriteSector(sector, (char *)this); 
+    dirty = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -309,46 +382,21 @@ void FileHeader::WriteBack(int sector) {
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	Index blocks are only read from disk the first time they are
+//	needed; after that the translation is done entirely in memory.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int FileHeader::ByteToSector(int offset){
-    offset /= SectorSize;
-    if(offset < NumDirect) return dataSectors[offset];    // 直接索引
-    offset -= NumDirect;
-    if(offset < NumIndirect){       // 一级索引
-        int *buffer = new int[NumIndirect];
-        synchDisk->ReadSector(dataSectors[NumDirect], (char *)buffer);
-        int sector = buffer[offset];
-        delete[] buffer;
-        return sector;
-    }
-    offset -= NumIndirect;
-    if(offset < NumIndirect * NumIndirect){  // 二级索引
-        int *buffer = new int[NumIndirect];
-        synchDisk->ReadSector(dataSectors[NumDirect + 1], (char *)buffer);
-        int sector = buffer[offset / NumIndirect];
-        synchDisk->ReadSector(sector, (char *)buffer);
-        offset %= NumIndirect;
-        sector = buffer[offset];
-        delete[] buffer;
-        return sector;
-    }
-    offset -= NumIndirect * NumIndirect;
-    if(offset < NumIndirect * NumIndirect * NumIndirect){  // 三级索引
-        int *buffer = new int[NumIndirect];
-        synchDisk->ReadSector(dataSectors[NumDirect + 2], (char *)buffer);
-        int sector = buffer[offset / NumIndirect / NumIndirect];
-        synchDisk->ReadSector(sector, (char *)buffer);
-        offset %= NumIndirect * NumIndirect;
-        sector = buffer[offset / NumIndirect];
-        synchDisk->ReadSector(sector, (char *)buffer);
-        offset %= NumIndirect;
-        sector = buffer[offset];
-        delete[] buffer;
-        return sector;
-    }
-    ASSERT(FALSE);      // 太长
+    int sector = BlockToSector(offset / blockSize);
+    return sector ? sector + offset % blockSize / SectorSize : 0;
+}
+
+int FileHeader::BlockToSector(int block){
+    IndexBlock *owner;
+    int *slot = BlockSlot(block, NULL, &owner);
+    return slot ? *slot : 0;
 }
 
 //----------------------------------------------------------------------
@@ -359,7 +407,133 @@ int FileHeader::ByteToSector(int offset){
 int
 FileHeader::FileLength()
 {
-    return numBytes;
+    return pendingBytes > numBytes ? pendingBytes : numBytes;
+}
+
+int FileHeader::blockSize = SectorSize;
+int FileHeader::sectorsPerBlock = 1;
+int FileHeader::reservedSectors = 0;
+
+//----------------------------------------------------------------------
+// FileHeader::HoleSectors
+// 	Return the number of sectors that filling the hole "block" will
+//	take when the file is flushed: the block itself, and the index
+//	blocks on the way to it, unless they are already on disk or some
+//	other buffered page of the same index block has counted them.
+//----------------------------------------------------------------------
+
+int FileHeader::HoleSectors(int block){
+    IndexBlock *owner;
+    int need = sectorsPerBlock;
+    if(block < (int)NumDirect || BlockSlot(block, NULL, &owner) != NULL)
+        return need;
+    int group = (block - NumDirect) / NumIndirect;  // 所在的末级索引块
+    for(FilePage *page = pages;page != NULL;page = page->next)
+        if(page->block >= (int)NumDirect
+           && (int)((page->block - NumDirect) / NumIndirect) == group)
+            return need;
+    int rest = block - (int)NumDirect - (int)NumIndirect;
+    need++;                                         // 一级索引
+    if(rest >= 0) need++;                           // 二级索引
+    if(rest >= (int)(NumIndirect * NumIndirect)) need++;   // 三级索引
+    return need;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FindPage
+// 	Return the buffered page holding block "block" of the file, or
+//	NULL if there is none and "create" is FALSE.  A new page starts
+//	out with the block's contents on disk, or zeros if the block has
+//	not been allocated.  Sequential access starts looking from the
+//	page used last, so appending does not walk the whole list.
+//
+//	The space a new page of a hole will need is reserved up front, so
+//	that the flush cannot run out of disk; if the free sectors are
+//	all spoken for, no page is created and NULL is returned.
+//----------------------------------------------------------------------
+
+FilePage *FileHeader::FindPage(int block, bool create){
+    FilePage **link = &pages;
+    if(lastPage != NULL && lastPage->block <= block){
+        if(lastPage->block == block) return lastPage;
+        link = &lastPage->next;
+    }
+    while(*link != NULL && (*link)->block < block) link = &(*link)->next;
+    if(*link != NULL && (*link)->block == block) return lastPage = *link;
+    if(!create) return NULL;
+
+    int sector = BlockToSector(block);
+    if(sector == 0){
+        int need = HoleSectors(block);
+        if(fileSystem->freeMap->NumClear() - reservedSectors < need)
+            return NULL;                            // 磁盘已满
+        reserved += need;
+        reservedSectors += need;
+    }
+    FilePage *page = new FilePage(block);
+    int valid = numBytes - block * blockSize;    // 块中文件末尾之前的字节数
+    if(valid > blockSize) valid = blockSize;
+    if(sector != 0 && valid > 0)
+        journal->ReadSectors(sector, page->data, divRoundUp(valid, SectorSize));
+    else valid = 0;
+    if(valid < blockSize) bzero(&page->data[valid], blockSize - valid);
+    page->next = *link;
+    *link = page;
+    numPages++;
+    return lastPage = page;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ExtendPending
+// 	Note that buffered data extends the file to "fileSize" bytes; the
+//	blocks are allocated when the file is flushed.
+//----------------------------------------------------------------------
+
+void FileHeader::ExtendPending(int fileSize){
+    if(fileSize > FileLength()) pendingBytes = fileSize;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Flush
+// 	Write the buffered pages of the file to disk, in block order.  If
+//	the file has grown, it gets its new length first; blocks are only
+//	allocated for the pages written, so the blocks in between that
+//	were never written are left as holes.  The new size, the
+//	allocation and the data form a single journal operation.
+//
+//	The space was reserved by FindPage; should the disk fill up all
+//	the same (space taken by directories and headers is not
+//	reserved), the pages that do not fit are reported and dropped.
+//
+//	"sector" is the disk sector containing the file header
+//----------------------------------------------------------------------
+
+void FileHeader::Flush(int sector){
+    if(!HasPending()) return;
+    journal->Begin();
+    if(pendingBytes > numBytes) ExpandSize(fileSystem->freeMap, pendingBytes, TRUE);
+    pendingBytes = 0;
+
+    while(pages != NULL){
+        FilePage *page = pages;
+        int dataSector = AllocateBlock(page->block, fileSystem->freeMap);
+        if(dataSector != -1)
+            journal->WriteData(dataSector, page->data, sectorsPerBlock);
+        else
+            printf("Disk full, block %d of the file at sector %d is lost\n",
+                   page->block, sector);
+        pages = page->next;
+        delete page;
+        numPages--;
+    }
+    lastPage = NULL;
+    reservedSectors -= reserved;    // 已经真正分配了
+    reserved = 0;
+    for(int level = 0;level < 3;level++) FlushIndex(index[level]);
+
+    if(dirty) WriteBack(sector);
+    fileSystem->freeMap->WriteDirty(fileSystem->freeMapFile);
+    journal->End();
 }
 
 //----------------------------------------------------------------------
@@ -379,12 +553,13 @@ FileHeader::Print()
     printf("Created time: %s", asctime(localtime(&createdTime)));
     printf("Last visited time: %s", asctime(localtime(&lastVisitedTime)));
     printf("Last modified time: %s", asctime(localtime(&lastModifiedTime)));
+    printf("Block size: %d.\n", blockSize);
     puts("File blocks:");
-    for (i = 0; i < numSectors; i++) printf("%d ", ByteToSector(i * SectorSize));
+    for (i = 0; i < numBlocks; i++) printf("%d ", BlockToSector(i));
     /*
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++) {
-	    synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
+    for (i = k = 0; i < numBlocks; i++) {
+	    journal->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
             if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
                 printf("%c", data[j]);
@@ -396,10 +571,87 @@ FileHeader::Print()
     delete [] data;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Check
+// 	Claim the sectors used by the file whose header was fetched from
+//	"sector": the header, the index blocks and the data blocks, and
+//	count the runs of data blocks that are contiguous on disk.  The
+//	index blocks are read from disk rather than from the cache, so the
+//	check sees what the next boot would.
+//
+//	Return FALSE if the block map points off the disk or into another
+//	file, in which case the contents of the file cannot be trusted.
+//----------------------------------------------------------------------
+
+bool FileHeader::Check(int sector, CheckReport *report){
+    bool ok = report->Claim(sector, 1, "header");
+    report->headerSectors++;
+    int last = -1;                  // 上一个数据块的扇区
+    for(int i = 0;i < NumDirect && i < numBlocks;i++)
+        if(dataSectors[i] != 0) ok = CheckBlock(dataSectors[i], &last, report) && ok;
+    int first = NumDirect, span = NumIndirect;
+    for(int level = 0;level < 3;level++){
+        int sectorNum = dataSectors[NumDirect + level];
+        if(sectorNum != 0)
+            ok = CheckIndex(sectorNum, first, span / NumIndirect, &last, report) && ok;
+        first += span;
+        span *= NumIndirect;
+    }
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CheckIndex
+// 	Check the index block at "sector" and everything below it.
+//	"first" and "span" are as for LoadIndex; "*last" is the sector of
+//	the previous data block of the file.
+//----------------------------------------------------------------------
+
+bool FileHeader::CheckIndex(int sector, int first, int span, int *last,
+                            CheckReport *report){
+    if(!report->Claim(sector, 1, "index block")) return FALSE;
+    report->indexSectors++;
+    int entries[NumIndirect];
+    journal->ReadSector(sector, (char *)entries);
+    bool ok = TRUE;
+    for(int i = 0;i < NumIndirect && first + i * span < numBlocks;i++){
+        if(entries[i] == 0) continue;       // 空洞
+        if(span > 1)
+            ok = CheckIndex(entries[i], first + i * span, span / NumIndirect,
+                            last, report) && ok;
+        else ok = CheckBlock(entries[i], last, report) && ok;
+    }
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CheckBlock
+// 	Claim the data block at "sector", starting a new extent unless it
+//	follows straight on from the previous block "*last".
+//----------------------------------------------------------------------
+
+bool FileHeader::CheckBlock(int sector, int *last, CheckReport *report){
+    bool ok = report->Claim(sector, sectorsPerBlock, "data block");
+    report->dataSectors += sectorsPerBlock;
+    report->blocks++;
+    if(*last == -1 || sector != *last + sectorsPerBlock) report->extents++;
+    *last = sector;
+    return ok;
+}
+
+// 时间只精确到秒，同一秒内的多次访问不必再写回文件头
 void FileHeader::UpdateVisitedTime(){
-    lastVisitedTime = time(0);
+    time_t now = time(0);
+    if(now != lastVisitedTime){
+        lastVisitedTime = now;
+        dirty = TRUE;
+    }
 }
 
 void FileHeader::UpdateModifiedTime(){
-    lastVisitedTime = lastModifiedTime = time(0);
+    time_t now = time(0);
+    if(now != lastModifiedTime || now != lastVisitedTime){
+        lastVisitedTime = lastModifiedTime = now;
+        dirty = TRUE;
+    }
 }
\ No newline at end of file
@@ -18,9 +18,16 @@
 #include "bitmap.h"
 #include <ctime>
 
+// File data is kept in blocks of FileHeader::blockSize bytes -- a
+// power-of-two number of consecutive sectors, chosen when the disk is
+// formatted.  The header and the index blocks are one sector each; each
+// of their entries is the first sector of a data block (or, in the
+// upper levels, the sector of an index block).
 #define NumDirect 	(((SectorSize - sizeof(int) - sizeof(FileType) - 3 * sizeof(time_t)) / sizeof(int)) - 3)
 #define NumIndirect (SectorSize / sizeof(int))
-#define MaxFileSize 	((NumDirect + NumIndirect + NumIndirect * NumIndirect + NumIndirect * NumIndirect * NumIndirect) * SectorSize)
+#define MaxFileBlocks	(NumDirect + NumIndirect + NumIndirect * NumIndirect + NumIndirect * NumIndirect * NumIndirect)
+#define MaxFileSize 	(MaxFileBlocks * FileHeader::blockSize)
+#define MaxBlockSize	(SectorsPerTrack * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -36,8 +43,50 @@
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
+//
+// Files may be sparse: a data block (or a whole index block) whose
+// sector number is 0 is a hole, which reads as zeros and takes up no
+// space on disk until something is written there.
+
+class ReadWriteLock;
+class Directory;
+class CheckReport;
+
+// A page of file data written by OpenFile::WriteAt but not yet written
+// to disk.  Small writes to the same block are absorbed by its page,
+// and adjacent pages are written out together, in order, when the file
+// is flushed; the blocks for data past the end of the file are only
+// allocated then, once the final size is known.
+#define MaxBufferedPages	64	// pages buffered per file; past
+					// this, the file is flushed
+
+class FilePage {
+  public:
+    FilePage(int whichBlock);		// A page for block "whichBlock"
+    ~FilePage();
+
+    int block;				// Which block of the file this is
+    char *data;				// Contents of the block
+    FilePage *next;			// Next buffered page, in block order
+};
 
-class Lock;
+// In-memory copy of one index (indirect) block of a file.  Index blocks
+// are read from disk the first time they are needed and then kept for as
+// long as the FileHeader stays in memory, so translating an offset never
+// has to go back to disk for the index sectors -- only the data I/O does.
+
+class IndexBlock {
+  public:
+    IndexBlock(int sectorNumber);	// Cache the index block at "sectorNumber"
+    ~IndexBlock();			// Drop the cached block and its children
+
+    int sector;				// Where the block lives on disk
+    int entries[NumIndirect];		// Sector numbers stored in the block,
+					// 0 for entries not in use
+    IndexBlock **children;		// Cached child blocks (NULL until a
+					// child is loaded, and for the last level)
+    bool dirty;				// Modified since it was last written?
+};
 
 enum FileType { DirectoryFile, NormalFile };
 
@@ -45,10 +94,18 @@ class FileHeader {
   public:
     FileHeader();
     ~FileHeader();
-    bool Allocate(BitMap *bitMap, int fileSize, FileType fileType);// Initialize a file header, 
+    bool Allocate(BitMap *bitMap, int fileSize, FileType fileType,
+		  bool sparse = FALSE);	// Initialize a file header, 
 						//  including allocating space 
-						//  on disk for the file data
-    bool ExpandSize(BitMap *bitMap, int fileSize);
+						//  on disk for the file data,
+						//  unless it is to be sparse
+    bool ExpandSize(BitMap *bitMap, int fileSize, bool sparse = FALSE);
+					// Grow the file; a sparse file
+					// just gets longer, with a hole
+    int AllocateBlock(int block, BitMap *bitMap);
+					// Return the sector of data block
+					// "block", allocating it if it is
+					// a hole
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
 						//  data blocks
 
@@ -59,28 +116,75 @@ class FileHeader {
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
 					// the byte
+    int BlockToSector(int block);	// First sector of a data block, or
+					// 0 if it is a hole
 
     int FileLength();			// Return the length of the file 
 					// in bytes
 
     void Print();			// Print the contents of the file.
+    bool Check(int sector, CheckReport *report);
+					// Claim the sectors of the file
+					// with header at "sector"; FALSE
+					// if its block map is damaged
+
+    FilePage *FindPage(int block, bool create);
+					// Return the buffered page for
+					// "block", creating it if asked to
+    void ExtendPending(int fileSize);	// Buffered data now reaches "fileSize"
+    void Flush(int sectorNumber);	// Allocate space for and write out
+					// the buffered pages
+    bool HasPending() { return pages != NULL || pendingBytes > numBytes; }
+
+    static int blockSize;		// Bytes in a block of file data
+    static int sectorsPerBlock;		//   and the sectors that make it up
+    static int reservedSectors;		// Free sectors set aside for the
+					// buffered pages of all files
 
     void UpdateVisitedTime();
     void UpdateModifiedTime();
     FileType GetFileType() {return fileType;}
 
   private:
+    int *BlockSlot(int block, BitMap *freeMap, IndexBlock **owner);
+					// Locate the entry holding the sector
+					// of data block "block", allocating
+					// index blocks if "freeMap" is given
+    IndexBlock *LoadIndex(IndexBlock **cache, int *sectorPtr, int first, 
+			  int span, BitMap *freeMap, IndexBlock *parent);
+    void FreeIndex(IndexBlock *block, int first, int span, BitMap *freeMap);
+    void FlushIndex(IndexBlock *block);	// Write back dirty index blocks
+    void DropIndex();			// Forget the cached index blocks
+    bool CheckIndex(int sector, int first, int span, int *last,
+		    CheckReport *report);
+					// Check an index block on disk, and
+					// the blocks it points to
+    bool CheckBlock(int sector, int *last, CheckReport *report);
+					// ... and one data block
+    int HoleSectors(int block);		// Sectors needed to fill a hole
+
     int numBytes;			// Number of bytes in the file
     FileType fileType;            // 文件类型
     time_t createdTime;           // 创建时间
     time_t lastVisitedTime;       // 上次访问时间
     time_t lastModifiedTime;      // 上次修改时间
     int dataSectors[NumDirect + 3];		// Disk sector numbers for each data block in the file
-    int numSectors;			// Number of data sectors in the file
+    int numBlocks;			// Number of data blocks in the file
     char *path;                   // 路径，仅存储在内存中
+    IndexBlock *index[3];         // 一、二、三级索引块缓存，仅存储在内存中
+    FilePage *pages;              // 尚未写回的数据页，按块号排序，仅存储在内存中
+    FilePage *lastPage;           // 上次访问的页，顺序写时从这里开始查找
+    int pendingBytes;             // 包括缓冲数据在内的文件长度
+    int reserved;                 // 为缓冲的空洞页预留的扇区数
   public:
-    Lock *lock;
-    int refcount=0;
+    int numPages;                 // 缓冲的数据页数
+    Directory *directory;         // 目录文件解码后的内容缓存，仅存储在内存中
+    ReadWriteLock *lock;          // 读者共享，修改长度、块映射或数据时独占
+    int refcount=0;               // 打开此文件的 OpenFile 数目
+    int cachedSector;             // 在 openfile_table 中的位置（文件头所在扇区）
+    FileHeader *nextClosed;       // 已关闭文件头的 LRU 链表，见 openfile.cc
+    bool dirty;                   // 内存中的文件头是否有未写回的修改
+    bool removed;                 // 文件已被删除，最后一次关闭时丢弃文件头
 };
 
 #endif // FILEHDR_H
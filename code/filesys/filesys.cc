@@ -21,23 +21,32 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
+//	The bitmap is read into memory once, when the file system starts,
+//	and kept there.  Operations that change it (Create, Remove, and
+//	writes that extend a file) change the in-memory copy; only the
+//	sectors of the bitmap file that changed are written back, at sync
+//	points: at the end of Create and Remove, when a file is closed for
+//	the last time, and on an explicit Sync.
+//
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
 //	are written immediately back to disk (the two files are kept
 //	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	modified part of the directory and/or bitmap, we undo the changes
+//	before returning.
 //
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//
+//	Updates to metadata (file headers, directories, the bitmap) go
+//	through the journal (cf. journal.h): each Create or Remove is one
+//	journal operation, so if Nachos exits in the middle of it, the disk
+//	is left as it was before or after the operation, never in between.
+//	Operations not yet committed when Nachos exits are lost; Sync
+//	commits them.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -52,20 +61,13 @@
 #include "system.h"
 #include "string.h"
 
-// Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known 
-// sectors, so that they can be located on boot-up.
-#define FreeMapSector 		0
-#define DirectorySector 	1
-#define PipeSector          2
-
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; directories grow
+// as files are added to them.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+#define SuperMagic		0x4e534642	// Marks a formatted disk
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -74,20 +76,44 @@
 //	not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory, after reading the
+//	block size from the superblock (a disk without one predates it,
+//	and uses one-sector blocks).
 //
 //	"format" -- should we initialize the disk?
+//	"blockSize" -- if formatting, the size of a block of file data:
+//		a power-of-two multiple of SectorSize, up to a track
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, int blockSize)
 { 
+    char buf[SectorSize];
+    SuperBlock *super = (SuperBlock *)buf;
+
     DEBUG('f', "Initializing the file system.\n");
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
+        bzero(buf, SectorSize);
+        super->magic = SuperMagic;
+        super->blockSize = blockSize;
+        super->numSectors = NumSectors;
+        journal->WriteSector(SuperSector, buf);
+    } else {
+        journal->ReadSector(SuperSector, buf);
+        if (super->magic != SuperMagic) super->blockSize = SectorSize;
+        else if (super->numSectors != 0)	// 0: formatted before it was kept
+            ASSERT(super->numSectors == NumSectors);
+    }
+    blockSize = super->blockSize;
+    ASSERT(blockSize >= SectorSize && blockSize <= MaxBlockSize &&
+           (blockSize & (blockSize - 1)) == 0);
+    FileHeader::blockSize = blockSize;
+    FileHeader::sectorsPerBlock = blockSize / SectorSize;
+
+    if (format) {
+        freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
-        FileHeader *pipeHdr = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
 
@@ -95,14 +121,15 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
         freeMap->Mark(FreeMapSector);	    
         freeMap->Mark(DirectorySector);
-        freeMap->Mark(PipeSector);
+        freeMap->Mark(SuperSector);
+        for (int i = JournalSector; i < LogStart + LogSize; i++)
+            freeMap->Mark(i);		// journal superblock and log
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
 
         ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize, NormalFile));
         ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize, DirectoryFile));
-        ASSERT(pipeHdr->Allocate(freeMap, 0, NormalFile));
 
     // Flush the bitmap and directory FileHeaders back to disk
     // We need to do this before we can "Open" the file, since open
@@ -112,7 +139,6 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing headers back to disk.\n");
         mapHdr->WriteBack(FreeMapSector);    
         dirHdr->WriteBack(DirectorySector);
-        pipeHdr->WriteBack(PipeSector);
 
     // OK to open the bitmap and directory files now
     // The file system operations assume these two files are left open
@@ -120,8 +146,6 @@ FileSystem::FileSystem(bool format)
 
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
-        pipeIn = new OpenFile(PipeSector);
-        pipeOut = new OpenFile(PipeSector);
      
     // Once we have the files "open", we can write the initial version
     // of each file back to disk.  The directory at this point is completely
@@ -137,74 +161,91 @@ FileSystem::FileSystem(bool format)
             freeMap->Print();
             directory->Print();
 
-            delete freeMap; 
             delete directory; 
             delete mapHdr; 
             delete dirHdr;
-            delete pipeHdr;
         }
+        nameCache = new NameCache(NameCacheSize);
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
 
-        BitMap *freeMap = new BitMap(NumSectors);
+        freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
-        FileHeader *pipeHdr = new FileHeader;
-        pipeHdr->FetchFrom(PipeSector);
-        pipeHdr->Deallocate(freeMap);
-        pipeHdr->Allocate(freeMap, 0, NormalFile);
-        pipeHdr->WriteBack(PipeSector);
-        freeMap->WriteBack(freeMapFile);
-        delete freeMap;
-        delete pipeHdr;
-        pipeIn = new OpenFile(PipeSector);
-        pipeOut = new OpenFile(PipeSector);
+        nameCache = new NameCache(NameCacheSize);
     }
+    journal->Sync();
 }
 
+//----------------------------------------------------------------------
+// FileSystem::LoadDirectory
+// 	Return the decoded contents of the directory stored in "file".
+//	The directory is read from disk once and then kept with the
+//	in-memory file header, so it is shared by every OpenFile on the
+//	same directory; the caller must not delete it.
+//----------------------------------------------------------------------
+
+Directory *FileSystem::LoadDirectory(OpenFile *file){
+    FileHeader *hdr = file->GetHeader();
+    if(hdr->directory == NULL){
+        hdr->directory = new Directory(0);
+        hdr->directory->FetchFrom(file);
+    }
+    return hdr->directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindDir
+// 	Find the directory holding the file named by the path "name", and
+//	advance "name" past the directory part, to the last component.
+//	Return the open directory file, or NULL if some component of the
+//	path is missing or is not a directory.
+//
+//	Each component is looked up in the name cache first; only the
+//	components that miss are read from disk, and then entered in the
+//	cache (including the ones that turn out not to exist).
+//----------------------------------------------------------------------
+
 OpenFile* FileSystem::FindDir(char *&name){
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openfile = directoryFile;
-    directory->FetchFrom(openfile);
+    char component[FileNameMaxLen + 1];
+    int parent = DirectorySector;
+    OpenFile *openfile = directoryFile;     // parent 打开的文件，未打开时为 NULL
     while(true){
         int i = 0;
         while(name[i] && name[i] != '/') i++;
         if(name[i] == 0) break;
-        char *buffer = new char[i];
-        memcpy(buffer, name, i * sizeof(char));
-        buffer[i] = 0;
-        int sector = directory->Find(buffer);
-        delete[] buffer;
+        int len = i < FileNameMaxLen ? i : FileNameMaxLen;
+        memcpy(component, name, len * sizeof(char));
+        component[len] = 0;
         name += i + 1;
-        if(openfile != directoryFile) delete openfile;
-        if(sector < 0) {
-            openfile = 0;
-            break;
+
+        int sector;
+        bool isDir;
+        OpenFile *child = NULL;
+        if(!nameCache->Lookup(parent, component, &sector, &isDir)){
+            if(openfile == NULL) openfile = new OpenFile(parent);
+            sector = LoadDirectory(openfile)->Find(component);
+            isDir = FALSE;
+            if(sector >= 0){
+                child = new OpenFile(sector);
+                isDir = child->IsDir();
+            }
+            nameCache->Enter(parent, component, sector, isDir);
         }
-        openfile = new OpenFile(sector);
-        if(!openfile->IsDir()) {      // 检测是否是目录
-            delete openfile;
-            openfile = 0;
-            break;
+        if(openfile != directoryFile) delete openfile;
+        openfile = child;
+        if(sector < 0 || !isDir) {      // 检测是否是目录
+            if(openfile) delete openfile;
+            return NULL;
         }
-        directory->FetchFrom(openfile);
+        parent = sector;
     }
-    delete directory;
+    if(openfile == NULL) openfile = new OpenFile(parent);
     return openfile;
 }
 
-void FileSystem::WritePipe(char *into, int numBytes){
-    pipeIn->Write(into, numBytes);
-    pipeIn->GetHeader()->WriteBack(PipeSector);
-}
-
-void FileSystem::ReadPipe(char *into, int numBytes){
-    pipeOut->Read(into, numBytes);
-    pipeOut->GetHeader()->WriteBack(PipeSector);
-}
-
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
@@ -215,6 +256,8 @@ void FileSystem::ReadPipe(char *into, int numBytes){
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
+//	    (directories only: an ordinary file starts out as one big
+//	    hole, and gets its blocks as they are written)
 //	  Add the name to the directory
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
@@ -224,9 +267,12 @@ void FileSystem::ReadPipe(char *into, int numBytes){
 // 	Create fails if:
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
+//	The directory is the cached copy kept with its file header, so
+//	if Create fails after the name was added, the name is taken out
+//	again rather than simply discarding the changed version.
+//
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
 //
@@ -238,7 +284,6 @@ bool
 FileSystem::Create(char *name, int initialSize)
 {
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
@@ -247,25 +292,27 @@ FileSystem::Create(char *name, int initialSize)
 
     OpenFile *dirFile = FindDir(name);
     if(dirFile == NULL) return FALSE;
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(dirFile);
+    journal->Begin();
+    directory = LoadDirectory(dirFile);
 
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
+        else if (!directory->Add(name, sector)){
+            freeMap->Clear(sector);
             success = FALSE;	// no space in directory
-        else {
+        }else {
             hdr = new FileHeader;
             if(initialSize == -1){
-                if (!hdr->Allocate(freeMap, DirectoryFileSize, DirectoryFile))
+                if (!hdr->Allocate(freeMap, DirectoryFileSize, DirectoryFile)){
+                    hdr->Deallocate(freeMap);	// whatever did fit
+                    directory->Remove(name);
+                    freeMap->Clear(sector);
                     success = FALSE;
-                else{
+                }else{
                     success = TRUE;
                     hdr->WriteBack(sector); 
                     Directory *newDir = new Directory(NumDirEntries);
@@ -274,25 +321,30 @@ FileSystem::Create(char *name, int initialSize)
                     delete openfile;
                     delete newDir;
                     directory->WriteBack(dirFile);
-                    freeMap->WriteBack(freeMapFile);
+                    dirFile->GetHeader()->WriteBack(dirFile->GetSector());
+                    freeMap->WriteDirty(freeMapFile);
+                    nameCache->Invalidate(dirFile->GetSector(), name);
                 }
             }else{
-                if (!hdr->Allocate(freeMap, initialSize, NormalFile))
+                if (!hdr->Allocate(freeMap, initialSize, NormalFile, TRUE)){
+                    directory->Remove(name);
+                    freeMap->Clear(sector);
                     success = FALSE;	// no space on disk for data
-                else {	
+                }else {	
                     success = TRUE;
                 // everthing worked, flush all changes back to disk
                     hdr->WriteBack(sector); 		
                     directory->WriteBack(dirFile);
-                    freeMap->WriteBack(freeMapFile);
+                    dirFile->GetHeader()->WriteBack(dirFile->GetSector());
+                    freeMap->WriteDirty(freeMapFile);
+                    nameCache->Invalidate(dirFile->GetSector(), name);
                 }
             }
             delete hdr;
         }
-        delete freeMap;
     }
     if(dirFile != directoryFile)delete dirFile;
-    delete directory;
+    journal->End();
     return success;
 }
 
@@ -314,13 +366,11 @@ OpenFile *FileSystem::Open(char *name){
     DEBUG('f', "Opening file %s\n", name);
     OpenFile *dirFile = FindDir(name);
     if(dirFile == NULL) return FALSE;
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(dirFile);
+    directory = LoadDirectory(dirFile);
     sector = directory->Find(name); 
     if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
     if(dirFile != directoryFile)delete dirFile;
-    delete directory;
     return openFile;				// return NULL if not found
 }
 
@@ -338,24 +388,30 @@ OpenFile *FileSystem::Open(char *name){
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
-bool FileSystem::RemoveFile(BitMap *freeMap, OpenFile *file){
+// 文件头缓存在 openfile_table 中，关闭后仍保留，需看引用计数
+bool FileSystem::IsOpen(int sector){
+    return openfile_table[sector] != NULL && openfile_table[sector]->refcount > 0;
+}
+
+bool FileSystem::RemoveFile(OpenFile *file){
     bool candelete = TRUE;
     if(file->IsDir()){
-        Directory *directory = new Directory(NumDirEntries);
-        directory->FetchFrom(file);
+        Directory *directory = LoadDirectory(file);
         for(int i=0;i<directory->tableSize;i++)if(directory->table[i].inUse){
             int sector = directory->table[i].sector;
-            if(!openfile_table[sector]){
+            if(!IsOpen(sector)){
                 OpenFile *openfile = new OpenFile(sector);
-                if(RemoveFile(freeMap, openfile)) directory->table[i].inUse = FALSE;
+                if(RemoveFile(openfile)) directory->Remove(directory->table[i].name);
                 else candelete = FALSE;
                 delete openfile;
             } else candelete = FALSE;
         }
         directory->WriteBack(file);
+        nameCache->Purge(file->GetSector());
     }
     if(candelete){
         file->GetHeader()->Deallocate(freeMap);
+        file->GetHeader()->removed = TRUE;
         freeMap->Clear(file->GetSector());
     }
     return candelete;
@@ -363,34 +419,32 @@ bool FileSystem::RemoveFile(BitMap *freeMap, OpenFile *file){
 
 bool FileSystem::Remove(char *name){ 
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
     int sector;
     
     OpenFile *dirFile = FindDir(name);
     if(dirFile == NULL) return FALSE;
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(dirFile);
+    directory = LoadDirectory(dirFile);
     sector = directory->Find(name);
     if (sector == -1) {
-       delete directory;
+       if(dirFile != directoryFile)delete dirFile;
        return FALSE;			 // file not found 
     }
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
-    if(!openfile_table[sector]){
+    journal->Begin();
+    if(!IsOpen(sector)){
         OpenFile *openfile = new OpenFile(sector);
-        if(RemoveFile(freeMap, openfile)) directory->Remove(name);
+        if(RemoveFile(openfile)){
+            directory->Remove(name);
+            nameCache->Invalidate(dirFile->GetSector(), name);
+        }
         delete openfile;
     }
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
+    freeMap->WriteDirty(freeMapFile);		// flush to disk
     directory->WriteBack(dirFile);        // flush to disk
     
     if(dirFile != directoryFile)delete dirFile;
-    delete directory;
-    delete freeMap;
+    journal->End();
     return TRUE;
 } 
 
@@ -410,17 +464,11 @@ void FileSystem::List(char *name){
         name = buffer;
         OpenFile *dirFile = FindDir(name);
         ASSERT(dirFile);
-        Directory *directory = new Directory(NumDirEntries);
-        directory->FetchFrom(dirFile);
-        directory->List();
+        LoadDirectory(dirFile)->List();
         delete[] buffer;
         if(dirFile != directoryFile)delete dirFile;
-        delete directory;
     }else{
-        Directory *directory = new Directory(NumDirEntries);
-        directory->FetchFrom(directoryFile);
-        directory->List();
-        delete directory;
+        LoadDirectory(directoryFile)->List();
     }
 }
 
@@ -439,9 +487,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    FileHeader *pipeHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -451,18 +496,255 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    printf("Pipe file header:\n");
-    pipeHdr->FetchFrom(PipeSector);
-    pipeHdr->Print();
-
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
-    directory->Print();
+    LoadDirectory(directoryFile)->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Flush the data buffered for every file, write back the file
+//	headers changed in memory (times, for one), write the parts of the
+//	bitmap of free sectors that changed since the last sync back to
+//	disk, and commit the journal, so everything done so far survives
+//	a crash -- of Nachos, or of the host, since the disk is then
+//	flushed to its UNIX file.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    for (int i = 0; i < NumSectors; i++) {
+        FileHeader *hdr = openfile_table[i];
+        if (hdr == NULL || hdr->removed)	// its sectors are free
+            continue;
+        if (hdr->HasPending() || hdr->dirty) {
+            OpenFile *file = new OpenFile(i);	// keep it in the table
+            hdr->lock->AcquireWrite();
+            hdr->Flush(i);
+            if (hdr->dirty)
+                hdr->WriteBack(i);
+            hdr->lock->ReleaseWrite();
+            delete file;
+        }
+    }
+    freeMap->WriteDirty(freeMapFile);
+    journal->Sync();
+    synchDisk->Sync();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::NeedsSync
+// 	Return TRUE if anything done so far would be lost if Nachos
+//	stopped now: data buffered for a file, a file header or part of
+//	the bitmap changed only in memory, or an uncommitted transaction.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::NeedsSync()
+{
+    for (int i = 0; i < NumSectors; i++) {
+        FileHeader *hdr = openfile_table[i];
+        if (hdr != NULL && !hdr->removed && (hdr->HasPending() || hdr->dirty))
+            return TRUE;
+    }
+    return freeMap->IsDirty() || journal->IsDirty();
+}
+
+//----------------------------------------------------------------------
+// CheckReport::CheckReport
+// 	Start a check of the file system whose bitmap of used sectors is
+//	"map", with nothing claimed yet.
+//----------------------------------------------------------------------
+
+CheckReport::CheckReport(BitMap *map)
+{
+    files = directories = 0;
+    headerSectors = indexSectors = dataSectors = metaSectors = 0;
+    blocks = extents = fragmented = 0;
+    entries = slots = 0;
+    leaked = lost = doubled = bad = 0;
+    path = "";
+    freeMap = map;
+    seen = new BitMap(NumSectors);
+}
+
+CheckReport::~CheckReport()
+{
+    delete seen;
+}
+
+//----------------------------------------------------------------------
+// CheckReport::Claim
+// 	Note that "count" sectors starting at "sector" are in use by the
+//	file being checked, as "what", and complain about any that are
+//	off the disk, already in use, or free in the bitmap.  Return FALSE
+//	if the sectors belong to someone else or do not exist.
+//----------------------------------------------------------------------
+
+bool
+CheckReport::Claim(int sector, int count, char *what)
+{
+    bool ok = TRUE;
+
+    for (int i = sector; i < sector + count; i++) {
+        if (i < 0 || i >= NumSectors) {
+            printf("%s: %s sector %d is not on the disk\n", path, what, i);
+            bad++;
+            return FALSE;
+        }
+        if (seen->Test(i)) {
+            printf("%s: %s sector %d is already in use\n", path, what, i);
+            doubled++;
+            ok = FALSE;
+            continue;
+        }
+        seen->Mark(i);
+        if (!freeMap->Test(i)) {
+            printf("%s: %s sector %d is marked free\n", path, what, i);
+            lost++;
+        }
+    }
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CheckFile
+// 	Check the file with header at "sector", named "path", and print
+//	how its data is laid out.  If it is a directory, and its block map
+//	is sound, check every file in it too.
+//----------------------------------------------------------------------
+
+void
+FileSystem::CheckFile(int sector, char *path, CheckReport *report)
+{
+    report->path = path;
+    if (sector < 0 || sector >= NumSectors || report->seen->Test(sector)) {
+        report->Claim(sector, 1, "header");	// complain, and stop here
+        return;
+    }
+
+    FileHeader *hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    int blocks = report->blocks, extents = report->extents;
+    bool ok = hdr->Check(sector, report);
+    blocks = report->blocks - blocks;
+    extents = report->extents - extents;
+    if (extents > 1)
+        report->fragmented++;
+
+    if (hdr->GetFileType() != DirectoryFile) {
+        report->files++;
+        printf("%s: %d bytes, %d blocks in %d extents%s\n", path,
+               hdr->FileLength(), blocks, extents, ok ? "" : ", damaged");
+        delete hdr;
+        return;
+    }
+
+    report->directories++;
+    if (!ok) {
+        printf("%s/: %d bytes, damaged; not checking its files\n", path,
+               hdr->FileLength());
+        delete hdr;
+        return;
+    }
+    OpenFile *file = new OpenFile(sector);
+    Directory *directory = new Directory(0);
+    directory->FetchFrom(file);
+    int used = 0;
+    for (int i = 0; i < directory->tableSize; i++)
+        if (directory->table[i].inUse)
+            used++;
+    report->entries += used;
+    report->slots += directory->tableSize;
+    printf("%s/: %d bytes, %d blocks in %d extents, %d of %d entries used\n",
+           path, hdr->FileLength(), blocks, extents, used,
+           directory->tableSize);
+    delete hdr;
+
+    for (int i = 0; i < directory->tableSize; i++) {
+        DirectoryEntry *entry = &directory->table[i];
+        if (!entry->inUse)
+            continue;
+        char *child = new char[strlen(path) + strlen(entry->name) + 2];
+        sprintf(child, "%s/%s", path, entry->name);
+        CheckFile(entry->sector, child, report);
+        delete [] child;
+    }
+    delete directory;
+    delete file;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check the file system, while it is in use: flush everything
+//	cached, then walk the directory tree from the root, reading each
+//	file header and index block once, and cross-check the sectors
+//	they use against the bitmap of free sectors.  Report
+//	  sectors used by two files, or off the disk
+//	  sectors in use but free in the bitmap
+//	  sectors marked in use that nothing reaches (leaks)
+//	and, for each file, how many runs of contiguous blocks ("extents")
+//	its data is in, and for each directory, how full it is.
+//
+//	Return the number of problems found.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Check()
+{
+    Sync();
+    CheckReport *report = new CheckReport(freeMap);
+
+    printf("Checking %d sectors, %d-byte blocks\n", NumSectors,
+           FileHeader::blockSize);
+    report->path = "[reserved]";
+    report->Claim(SuperSector, 1, "superblock");
+    report->Claim(JournalSector, LogStart + LogSize - JournalSector, "journal");
+    report->metaSectors = 1 + LogStart + LogSize - JournalSector;
+
+    FileHeader *mapHdr = new FileHeader;
+    report->path = "[free map]";
+    mapHdr->FetchFrom(FreeMapSector);
+    mapHdr->Check(FreeMapSector, report);
+    delete mapHdr;
+
+    CheckFile(DirectorySector, "", report);
+
+    for (int i = 0; i < NumSectors; i++) {	// in use, but not reached
+        if (!freeMap->Test(i) || report->seen->Test(i))
+            continue;
+        int j = i;
+        while (j + 1 < NumSectors && freeMap->Test(j + 1) &&
+               !report->seen->Test(j + 1))
+            j++;
+        printf("sectors %d-%d are marked in use, but not used\n", i, j);
+        report->leaked += j - i + 1;
+        i = j;
+    }
+
+    int used = report->headerSectors + report->indexSectors +
+               report->dataSectors + report->metaSectors;
+    printf("files=%d directories=%d\n", report->files, report->directories);
+    printf("sectors=%d used=%d free=%d headers=%d index=%d data=%d reserved=%d\n",
+           NumSectors, used, freeMap->NumClear(), report->headerSectors,
+           report->indexSectors, report->dataSectors, report->metaSectors);
+    printf("blocks=%d extents=%d avgExtent=%.2f fragmentedFiles=%d\n",
+           report->blocks, report->extents,
+           report->extents ? (double)report->blocks / report->extents : 0.0,
+           report->fragmented);
+    printf("dirEntries=%d dirSlots=%d dirFill=%.0f%%\n", report->entries,
+           report->slots,
+           report->slots ? 100.0 * report->entries / report->slots : 0.0);
+    printf("leaked=%d lost=%d doubled=%d bad=%d\n", report->leaked,
+           report->lost, report->doubled, report->bad);
+
+    int problems = report->leaked + report->lost + report->doubled + report->bad;
+    printf(problems ? "File system has %d problems\n" : "File system is clean\n",
+           problems);
+    delete report;
+    return problems;
+}
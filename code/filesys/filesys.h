@@ -46,7 +46,7 @@
 				// implementation is available
 class FileSystem {
   public:
-    FileSystem(bool format) {}
+    FileSystem(bool format, int blockSize = SectorSize) {}
 
     bool Create(char *name, int initialSize) { 
 	int fileDescriptor = OpenForWrite(name);
@@ -65,17 +65,73 @@ class FileSystem {
 
     bool Remove(char *name) { return Unlink(name) == 0; }
 
+    void Sync() {}
+
 };
 
 #else // FILESYS
+
+// Sectors containing the file headers for the bitmap of free sectors,
+// and the directory of files, and the superblock.  These are placed in
+// well-known sectors, so that they can be located on boot-up.  (The
+// journal, see journal.h, also starts at a well-known sector.)
+#define FreeMapSector 		0
+#define DirectorySector 	1
+#define SuperSector		2
+
+// The superblock records the parameters the disk was formatted with.
+class SuperBlock {
+  public:
+    int magic;
+    int blockSize;			// Bytes in a block of file data
+    int numSectors;			// Size of the disk the free map covers
+};
+
+// What FileSystem::Check found.  Every sector reached from the root
+// directory is claimed once; claiming a sector that is already claimed,
+// free in the bitmap, or off the disk is an error.
+class CheckReport {
+  public:
+    CheckReport(BitMap *map);
+    ~CheckReport();
+
+    bool Claim(int sector, int count, char *what);
+					// Claim "count" sectors starting at
+					// "sector"; FALSE if any is bad
+
+    int files, directories;		// Files reached from the root
+    int headerSectors, indexSectors, dataSectors, metaSectors;
+					// Sectors in use, by kind
+    int blocks, extents;		// Data blocks, and the runs of them
+					// that are contiguous on disk
+    int fragmented;			// Files in more than one extent
+    int entries, slots;			// Directory entries in use, and in all
+    int leaked;				// In use in the bitmap, but unreachable
+    int lost;				// Reachable, but free in the bitmap
+    int doubled;			// Reachable more than once
+    int bad;				// Not a sector of this disk
+    char *path;				// File being checked, for messages
+
+  private:
+    BitMap *freeMap;			// The bitmap being checked
+    BitMap *seen;			// Sectors claimed so far
+
+    friend class FileSystem;
+};
+
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, int blockSize = SectorSize);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
-    					// and the bitmap of free blocks.
+    					// and the bitmap of free blocks, and
+					// use "blockSize" byte blocks
+
+	Directory* LoadDirectory(OpenFile *file);	// Cached contents of a
+					// directory file
 
 	OpenFile* FindDir(char *&name);
 
@@ -84,7 +140,10 @@ class FileSystem {
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
-	bool RemoveFile(BitMap *freeMap, OpenFile *file);
+	bool IsOpen(int sector);		// Is the file with header at
+					// "sector" open?
+
+	bool RemoveFile(OpenFile *file);
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
@@ -92,16 +151,27 @@ class FileSystem {
 
     void Print();			// List all the files and their contents
 
-	void WritePipe(char *into, int numBytes);
+    void Sync();			// Flush cached file system state
+    bool NeedsSync();			// Would Sync write anything?
+
+    int Check();			// Cross-check the directory tree
+					// against the bitmap, and report
+					// on the layout; return the number
+					// of problems found
 
-	void ReadPipe(char *into, int numBytes);
+  private:
+    void CheckFile(int sector, char *path, CheckReport *report);
+					// Check one file, and everything
+					// below it if it is a directory
 
   public:
+    BitMap* freeMap;			// Bit map of free disk blocks, kept
+					// in memory while Nachos is running
     OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
     OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
-	OpenFile* pipeIn, *pipeOut;
+    NameCache* nameCache;		// Recent path component lookups
 };
 
 #endif // FILESYS
@@ -16,10 +16,12 @@
 
 #include "utility.h"
 #include "filesys.h"
+#include "filehdr.h"
 #include "system.h"
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "synch.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -224,21 +226,618 @@ void RemoveTest(){
     fileSystem->Remove("testdir");
 }
 
-void PipeInThread(int arg){
-    char buffer[100];
-    scanf("%s",buffer);
-    fileSystem->WritePipe(buffer, strlen(buffer)+1);
+//----------------------------------------------------------------------
+// PipeTest
+// 	Push PipeBytes bytes through a pipe, from a writer thread to a
+//	reader thread, in PipeChunk-byte pieces, and report the
+//	throughput.  The pipe is buffered in memory, so no disk I/O
+//	should be needed at all.
+//----------------------------------------------------------------------
+
+#define PipeBytes	(1024 * 1024)
+#define PipeChunk	512
+
+static OpenFile *pipeIn, *pipeOut;	// the read and write ends
+static int pipeStartTicks, pipeStartReads, pipeStartWrites;
+
+void PipeWriterThread(int arg){
+    char buffer[PipeChunk];
+    for(int i = 0; i < PipeChunk; i++) buffer[i] = 'a' + i % 26;
+    for(int sent = 0; sent < PipeBytes; sent += PipeChunk)
+        ASSERT(pipeOut->Write(buffer, PipeChunk) == PipeChunk);
+    delete pipeOut;                     // reader sees end of file
 }
 
-void PipeOutThread(int arg){
-    char buffer[100];
-    fileSystem->ReadPipe(buffer, 100);
-    printf("%s\n",buffer);
+void PipeReaderThread(int arg){
+    char buffer[PipeChunk];
+    int n, received = 0;
+    while((n = pipeIn->Read(buffer, PipeChunk)) > 0){
+        for(int i = 0; i < n; i++)
+            ASSERT(buffer[i] == 'a' + (received + i) % PipeChunk % 26);
+        received += n;
+    }
+    delete pipeIn;
+    ASSERT(received == PipeBytes);
+
+    int ticks = stats->totalTicks - pipeStartTicks;
+    printf("Pipe: %d bytes in %d-byte chunks, %d ticks, %d bytes/tick\n",
+        received, PipeChunk, ticks, ticks > 0 ? received / ticks : received);
+    printf("Pipe: disk reads %d, disk writes %d\n",
+        stats->numDiskReads - pipeStartReads,
+        stats->numDiskWrites - pipeStartWrites);
 }
 
 void PipeTest(){
-    Thread *t1 = new Thread("in thread");
-    Thread *t2 = new Thread("out thread");
-    t1->Fork(PipeInThread, 0);
-    t2->Fork(PipeOutThread, 0);
-}
\ No newline at end of file
+    PipeBuffer *pipe = new PipeBuffer("test pipe");
+    pipeIn = new OpenFile(pipe, FALSE);
+    pipeOut = new OpenFile(pipe, TRUE);
+    pipeStartTicks = stats->totalTicks;
+    pipeStartReads = stats->numDiskReads;
+    pipeStartWrites = stats->numDiskWrites;
+
+    Thread *t1 = new Thread("pipe writer");
+    Thread *t2 = new Thread("pipe reader");
+    t1->Fork(PipeWriterThread, 0);
+    t2->Fork(PipeReaderThread, 0);
+}
+
+//----------------------------------------------------------------------
+// PathTest
+// 	Open files a few directories deep over and over, and report how
+//	many path component lookups the name cache answered, and how many
+//	disk reads were needed.
+//----------------------------------------------------------------------
+
+#define PathRounds	20
+
+void PathTest(){
+    char *dirs[] = { "pa", "pa/pb", "pa/pb/pc" };
+    char *files[] = { "pa/f0", "pa/pb/f1", "pa/pb/pc/f2", "pa/pb/pc/none" };
+    int i, j, reads;
+
+    for(i = 0; i < 3; i++) fileSystem->Create(dirs[i], -1);
+    for(i = 0; i < 3; i++) fileSystem->Create(files[i], 0);
+
+    reads = stats->numDiskReads;
+    for(i = 0; i < PathRounds; i++)
+        for(j = 0; j < 4; j++){
+            OpenFile *openFile = fileSystem->Open(files[j]);
+            if((openFile == NULL) != (j == 3))
+                printf("Path test: wrong result opening %s\n", files[j]);
+            if(openFile) delete openFile;
+        }
+    printf("Path test: %d opens, %d disk reads\n", PathRounds * 4, 
+        stats->numDiskReads - reads);
+    fileSystem->nameCache->Print();
+
+    fileSystem->Remove("pa");
+    if(fileSystem->Open(files[0]) != NULL)
+        printf("Path test: %s still found after removing pa\n", files[0]);
+}
+
+//----------------------------------------------------------------------
+// JournalTest
+// 	Create and remove a batch of files, and report how many journal
+//	transactions that took, and how many sectors went to the log, to
+//	home locations, and to disk in total.
+//----------------------------------------------------------------------
+
+#define JournalFiles	16
+
+void JournalTest(){
+    char name[20];
+    int i, writes = stats->numDiskWrites;
+    int commits = journal->commits, logWrites = journal->logWrites;
+
+    for(i = 0; i < JournalFiles; i++){
+        sprintf(name, "jt%d", i);
+        if(!fileSystem->Create(name, 0))
+            printf("Journal test: can't create %s\n", name);
+    }
+    for(i = 0; i < JournalFiles; i++){
+        sprintf(name, "jt%d", i);
+        if(!fileSystem->Remove(name))
+            printf("Journal test: can't remove %s\n", name);
+    }
+    fileSystem->Sync();
+    printf("Journal test: %d creates and %d removes, %d commits, "
+        "%d log writes, %d disk writes\n", JournalFiles, JournalFiles,
+        journal->commits - commits, journal->logWrites - logWrites,
+        stats->numDiskWrites - writes);
+}
+
+//----------------------------------------------------------------------
+// JournalCrashTest, JournalReplayTest
+// 	Check that the journal brings the disk back after a crash, in
+//	two runs of Nachos: "nachos -f -tjc", then "nachos -tjr".
+//
+//	The first run creates and writes a file, and commits that to the
+//	log without checkpointing it; then it starts an operation that
+//	creates another file, and stops dead before it commits.  The
+//	second run must find that the log was replayed, that the first
+//	file is there with its data, that the second file is not, and
+//	that the disk is consistent.
+//----------------------------------------------------------------------
+
+#define CrashKept	"jc-kept"	// committed before the crash
+#define CrashLost	"jc-lost"	// not committed
+static char crashData[] = "survives the crash";
+#define CrashSize	((int)sizeof(crashData))
+
+void JournalCrashTest(){
+    ASSERT(fileSystem->Create(CrashKept, 0));
+    OpenFile *openFile = fileSystem->Open(CrashKept);
+    ASSERT(openFile->Write(crashData, CrashSize) == CrashSize);
+    delete openFile;			// writes the data home
+    fileSystem->Sync();			// commits the metadata to the log
+
+    journal->Begin();
+    ASSERT(fileSystem->Create(CrashLost, 0));
+    printf("Journal crash test: %d home writes so far, crashing\n",
+        journal->homeWrites);
+    Exit(0);				// no Cleanup, no commit
+}
+
+void JournalReplayTest(){
+    char buffer[CrashSize];
+
+    printf("Journal replay test: %d transactions replayed\n",
+        journal->replayed);
+    ASSERT(journal->replayed > 0);
+    OpenFile *openFile = fileSystem->Open(CrashKept);
+    ASSERT(openFile != NULL);
+    ASSERT(openFile->Read(buffer, CrashSize) == CrashSize);
+    ASSERT(!strcmp(buffer, crashData));
+    delete openFile;
+    openFile = fileSystem->Open(CrashLost);
+    ASSERT(openFile == NULL);
+    ASSERT(fileSystem->Check() == 0);
+    ASSERT(fileSystem->Remove(CrashKept));
+    printf("Journal replay test: passed\n");
+}
+
+//----------------------------------------------------------------------
+// ConcurrentReadTest
+// 	Fork "readers" threads that each read the same file from start to
+//	end, plus, if "withWriter", one thread that keeps overwriting it,
+//	and report how long it took them all, in simulated ticks.  Readers
+//	share the file header lock, so their disk requests overlap; the
+//	writer has to wait for all of them.
+//----------------------------------------------------------------------
+
+#define ReadPasses	4
+
+static Semaphore *readDone;
+
+static void ConcurrentReader(int arg){
+    OpenFile *openFile = fileSystem->Open(FileName);
+    char *buffer = new char[SectorSize];
+    for(int pass = 0; pass < ReadPasses; pass++)
+        for(int i = 0; i < FileSize; i += SectorSize)
+            openFile->ReadAt(buffer, SectorSize, i);
+    delete [] buffer;
+    delete openFile;
+    readDone->V();
+}
+
+static void ConcurrentWriter(int arg){
+    OpenFile *openFile = fileSystem->Open(FileName);
+    for(int pass = 0; pass < ReadPasses; pass++)
+        for(int i = 0; i < FileSize; i += ContentSize * 50)
+            openFile->WriteAt(Contents, ContentSize, i);
+    delete openFile;
+    readDone->V();
+}
+
+void ConcurrentReadTest(int readers, bool withWriter){
+    char *buffer = new char[FileSize];
+    int i, threads = readers + (withWriter ? 1 : 0);
+
+    for(i = 0; i < FileSize; i += ContentSize)
+        bcopy(Contents, &buffer[i], ContentSize);
+    fileSystem->Create(FileName, 0);
+    OpenFile *openFile = fileSystem->Open(FileName);
+    openFile->Write(buffer, FileSize);
+    delete openFile;
+    delete [] buffer;
+
+    readDone = new Semaphore("read done", 0);
+    int ticks = stats->totalTicks, reads = stats->numDiskReads;
+    for(i = 0; i < readers; i++)
+        (new Thread("reader"))->Fork(ConcurrentReader, i);
+    if(withWriter)
+        (new Thread("writer"))->Fork(ConcurrentWriter, 0);
+    for(i = 0; i < threads; i++)
+        readDone->P();
+    printf("Concurrent read test: %d readers, %d writers, %d bytes read, "
+        "%d ticks, %d disk reads\n", readers, withWriter ? 1 : 0,
+        readers * ReadPasses * FileSize, stats->totalTicks - ticks,
+        stats->numDiskReads - reads);
+    delete readDone;
+    fileSystem->Remove(FileName);
+}
+
+//----------------------------------------------------------------------
+// SparseTest
+// 	Create a big file, write one sector near its end, and check that
+//	only that sector (and the index blocks on the way to it) took up
+//	space, and that the rest of the file reads back as zeros, without
+//	any disk reads.
+//----------------------------------------------------------------------
+
+#define SparseSize	(64 * SectorSize)
+
+void SparseTest(){
+    char buffer[SectorSize];
+    int i, clear = fileSystem->freeMap->NumClear();
+
+    ASSERT(fileSystem->Create("sparse", SparseSize));
+    OpenFile *openFile = fileSystem->Open("sparse");
+    for(i = 0; i < SectorSize; i++) buffer[i] = 'x';
+    openFile->WriteAt(buffer, SectorSize, SparseSize - SectorSize);
+    delete openFile;                    // flushes the written sector
+    int used = clear - fileSystem->freeMap->NumClear();
+
+    openFile = fileSystem->Open("sparse");
+    int reads = stats->numDiskReads;
+    for(i = 0; i < SparseSize - SectorSize; i += SectorSize){
+        openFile->ReadAt(buffer, SectorSize, i);
+        for(int j = 0; j < SectorSize; j++)
+            if(buffer[j] != 0)
+                printf("Sparse test: byte %d of the hole is not zero\n", i + j);
+    }
+    printf("Sparse test: %d byte file, %d sectors used, "
+        "%d disk reads for the hole\n", openFile->Length(), used,
+        stats->numDiskReads - reads);
+    delete openFile;
+    fileSystem->Remove("sparse");
+}
+
+//----------------------------------------------------------------------
+// DiskFullTest
+// 	Write a file until the disk is full.  The write that does not fit
+//	must come back short, rather than the flush failing later, and all
+//	of what was written must be on disk after the file is closed.
+//----------------------------------------------------------------------
+
+void DiskFullTest(){
+    char buffer[SectorSize];
+    int i, written = 0, n;
+
+    for(i = 0; i < SectorSize; i++) buffer[i] = 'f';
+    ASSERT(fileSystem->Create("full", 0));
+    OpenFile *openFile = fileSystem->Open("full");
+    while((n = openFile->Write(buffer, SectorSize)) == SectorSize)
+        written += n;
+    written += n;
+    ASSERT(openFile->Write(buffer, SectorSize) == 0);
+    delete openFile;                    // flushes what fit
+    ASSERT(FileHeader::reservedSectors == 0);
+
+    openFile = fileSystem->Open("full");
+    ASSERT(openFile->Length() == written);
+    for(i = 0; i < written; i += SectorSize){
+        n = openFile->ReadAt(buffer, SectorSize, i);
+        for(int j = 0; j < n; j++)
+            if(buffer[j] != 'f')
+                printf("Disk full test: byte %d was not written\n", i + j);
+    }
+    printf("Disk full test: %d bytes written, %d sectors left free\n",
+        written, fileSystem->freeMap->NumClear());
+    delete openFile;
+    ASSERT(fileSystem->Remove("full"));
+}
+
+//----------------------------------------------------------------------
+// Benchmark
+// 	A benchmark of the file system, to compare configurations:
+//	  seq   -- sequential write, then read, of files of several sizes
+//	  rand  -- random writes, then reads, within the same files
+//	  storm -- create, then remove, a directory full of files
+//	  path  -- open a file many directories deep, over and over
+//	  mixed -- 1, 2 and 4 threads doing a random mix of reads, writes,
+//		   opens, creates and removes, each on its own file
+//	  all   -- all of the above
+//
+//	Each run prints one line of "key=value" fields:
+//	  bench=<run> block=<block bytes> size=<file bytes> threads=<n>
+//	  ops=<n> ticks=<n> reads=<n> writes=<n> wall=<host seconds>
+//	  hist=<h0>,<h1>,...
+//	where ticks, reads and writes are the simulated time and disk
+//	requests the run took (including the Sync at the end), and hist[i]
+//	counts the operations that took from 2^i to 2^(i+1)-1 ticks
+//	(hist[0] also counts those that took no time at all).  After each
+//	sequential write there is also a line giving the sectors the file
+//	took up on disk, for data and for metadata (its header and index
+//	blocks):
+//	  bench=layout block=<n> size=<n> data=<n> meta=<n> metaPerMB=<n>
+//
+//	Random offsets come from a fixed seed, so runs are repeatable.
+//----------------------------------------------------------------------
+
+#define BenchChunk	SectorSize	// bytes per read or write
+#define BenchHistSize	32		// log2 latency buckets
+#define BenchFiles	32		// files per create/remove storm
+#define BenchDepth	8		// directories above the path file
+#define BenchRounds	64		// opens per path run
+#define BenchOps	64		// operations per mixed thread
+#define BenchMixedSize	4096		// size of each mixed thread's file
+#define BenchSeed	1
+
+static int benchSizes[] = { 1024, 8192, 32768 };
+#define NumBenchSizes	((int)(sizeof(benchSizes) / sizeof(int)))
+
+class BenchRun {
+  public:
+    const char *name;			// what is being measured
+    int size, threads;			// parameters of the run
+    int ops;				// operations timed
+    int hist[BenchHistSize];		// their latencies, in log2 buckets
+    int ticks, reads, writes;		// totals at the start of the run
+    double wall;
+};
+
+static void
+BenchBegin(BenchRun *run, const char *name, int size, int threads)
+{
+    run->name = name;
+    run->size = size;
+    run->threads = threads;
+    run->ops = 0;
+    for (int i = 0; i < BenchHistSize; i++)
+	run->hist[i] = 0;
+    run->ticks = stats->totalTicks;
+    run->reads = stats->numDiskReads;
+    run->writes = stats->numDiskWrites;
+    run->wall = WallTime();
+}
+
+// Record one operation that started at simulated time "start".
+static void
+BenchRecord(BenchRun *run, int start)
+{
+    int ticks = stats->totalTicks - start, bucket = 0;
+
+    while (ticks > 1 && bucket < BenchHistSize - 1) {
+	ticks >>= 1;
+	bucket++;
+    }
+    run->hist[bucket]++;
+    run->ops++;
+}
+
+static void
+BenchEnd(BenchRun *run)
+{
+    int last = 0;
+
+    fileSystem->Sync();
+    printf("bench=%s block=%d size=%d threads=%d ops=%d ticks=%d reads=%d "
+	"writes=%d wall=%.6f hist=", run->name, FileHeader::blockSize,
+	run->size, run->threads, run->ops,
+	stats->totalTicks - run->ticks, stats->numDiskReads - run->reads,
+	stats->numDiskWrites - run->writes, WallTime() - run->wall);
+    for (int i = 0; i < BenchHistSize; i++)
+	if (run->hist[i] > 0)
+	    last = i;
+    for (int i = 0; i <= last; i++)
+	printf(i < last ? "%d," : "%d\n", run->hist[i]);
+}
+
+// Sequential, then random, writes and reads of a file of each size.
+static void
+BenchReadWrite(bool random)
+{
+    char buffer[BenchChunk];
+    BenchRun run;
+
+    bzero(buffer, BenchChunk);
+    for (int s = 0; s < NumBenchSizes; s++) {
+	int size = benchSizes[s], chunks = size / BenchChunk;
+	int clear = fileSystem->freeMap->NumClear();
+	OpenFile *openFile;
+
+	ASSERT(fileSystem->Create("bench", 0));
+	if (random) {			// lay the file out first, untimed
+	    openFile = fileSystem->Open("bench");
+	    for (int i = 0; i < chunks; i++)
+		openFile->Write(buffer, BenchChunk);
+	    delete openFile;
+	    fileSystem->Sync();
+	}
+
+	BenchBegin(&run, random ? "randwrite" : "seqwrite", size, 1);
+	openFile = fileSystem->Open("bench");
+	for (int i = 0; i < chunks; i++) {
+	    int start = stats->totalTicks;
+	    if (random)
+		openFile->WriteAt(buffer, BenchChunk,
+				(Random() % chunks) * BenchChunk);
+	    else
+		openFile->Write(buffer, BenchChunk);
+	    BenchRecord(&run, start);
+	}
+	delete openFile;
+	BenchEnd(&run);
+	if (!random) {
+	    int used = clear - fileSystem->freeMap->NumClear();
+	    int data = divRoundUp(size, FileHeader::blockSize) *
+			FileHeader::sectorsPerBlock;
+	    printf("bench=layout block=%d size=%d data=%d meta=%d "
+		"metaPerMB=%d\n", FileHeader::blockSize, size, data,
+		used - data, (used - data) * (1024 * 1024 / size));
+	}
+
+	BenchBegin(&run, random ? "randread" : "seqread", size, 1);
+	openFile = fileSystem->Open("bench");
+	for (int i = 0; i < chunks; i++) {
+	    int start = stats->totalTicks;
+	    if (random)
+		openFile->ReadAt(buffer, BenchChunk,
+				(Random() % chunks) * BenchChunk);
+	    else
+		ASSERT(openFile->Read(buffer, BenchChunk) == BenchChunk);
+	    BenchRecord(&run, start);
+	}
+	delete openFile;
+	BenchEnd(&run);
+
+	ASSERT(fileSystem->Remove("bench"));
+    }
+}
+
+// Create a directory full of files, then remove them all.
+static void
+BenchStorm()
+{
+    char name[20];
+    BenchRun run;
+
+    ASSERT(fileSystem->Create("bs", -1));
+    BenchBegin(&run, "create", 0, 1);
+    for (int i = 0; i < BenchFiles; i++) {
+	int start = stats->totalTicks;
+	sprintf(name, "bs/f%d", i);
+	ASSERT(fileSystem->Create(name, 0));
+	BenchRecord(&run, start);
+    }
+    BenchEnd(&run);
+
+    BenchBegin(&run, "remove", 0, 1);
+    for (int i = 0; i < BenchFiles; i++) {
+	int start = stats->totalTicks;
+	sprintf(name, "bs/f%d", i);
+	ASSERT(fileSystem->Remove(name));
+	BenchRecord(&run, start);
+    }
+    BenchEnd(&run);
+    ASSERT(fileSystem->Remove("bs"));
+}
+
+// Open a file BenchDepth directories down, over and over.
+static void
+BenchPath()
+{
+    char path[BenchDepth * 4 + 8];
+    BenchRun run;
+    int len = 0;
+
+    for (int i = 0; i < BenchDepth; i++) {
+	len += sprintf(path + len, i == 0 ? "d%d" : "/d%d", i);
+	ASSERT(fileSystem->Create(path, -1));
+    }
+    sprintf(path + len, "/file");
+    ASSERT(fileSystem->Create(path, 0));
+
+    BenchBegin(&run, "path", 0, 1);
+    for (int i = 0; i < BenchRounds; i++) {
+	int start = stats->totalTicks;
+	OpenFile *openFile = fileSystem->Open(path);
+	ASSERT(openFile != NULL);
+	delete openFile;
+	BenchRecord(&run, start);
+    }
+    BenchEnd(&run);
+    ASSERT(fileSystem->Remove("d0"));
+}
+
+// Each mixed thread works on its own file, "bm<n>".
+static BenchRun benchMixed;
+static Semaphore *benchDone;
+
+static void
+BenchMixedThread(int which)
+{
+    char name[20], temp[20], buffer[BenchChunk];
+    int chunks = BenchMixedSize / BenchChunk;
+
+    sprintf(name, "bm%d", which);
+    sprintf(temp, "bm%dt", which);
+    bzero(buffer, BenchChunk);
+    OpenFile *openFile = fileSystem->Open(name);
+    for (int i = 0; i < BenchOps; i++) {
+	int start = stats->totalTicks;
+	int offset = (Random() % chunks) * BenchChunk;
+	switch (Random() % 4) {
+	  case 0:
+	    openFile->ReadAt(buffer, BenchChunk, offset);
+	    break;
+	  case 1:
+	    openFile->WriteAt(buffer, BenchChunk, offset);
+	    break;
+	  case 2:
+	    delete fileSystem->Open(name);
+	    break;
+	  case 3:
+	    ASSERT(fileSystem->Create(temp, 0));
+	    ASSERT(fileSystem->Remove(temp));
+	    break;
+	}
+	BenchRecord(&benchMixed, start);
+    }
+    delete openFile;
+    benchDone->V();
+}
+
+static void
+BenchMixed(int threads)
+{
+    char name[20], buffer[BenchMixedSize];
+    int i;
+
+    bzero(buffer, BenchMixedSize);
+    for (i = 0; i < threads; i++) {
+	sprintf(name, "bm%d", i);
+	ASSERT(fileSystem->Create(name, 0));
+	OpenFile *openFile = fileSystem->Open(name);
+	openFile->Write(buffer, BenchMixedSize);
+	delete openFile;
+    }
+    fileSystem->Sync();
+
+    benchDone = new Semaphore("bench done", 0);
+    BenchBegin(&benchMixed, "mixed", BenchMixedSize, threads);
+    for (i = 0; i < threads; i++)
+	(new Thread("bench worker"))->Fork(BenchMixedThread, i);
+    for (i = 0; i < threads; i++)
+	benchDone->P();
+    BenchEnd(&benchMixed);
+    delete benchDone;
+
+    for (i = 0; i < threads; i++) {
+	sprintf(name, "bm%d", i);
+	ASSERT(fileSystem->Remove(name));
+    }
+}
+
+void
+Benchmark(char *which)
+{
+    bool all = !strcmp(which, "all"), any = FALSE;
+
+    RandomInit(BenchSeed);
+    if (all || !strcmp(which, "seq")) {
+	BenchReadWrite(FALSE);
+	any = TRUE;
+    }
+    if (all || !strcmp(which, "rand")) {
+	BenchReadWrite(TRUE);
+	any = TRUE;
+    }
+    if (all || !strcmp(which, "storm")) {
+	BenchStorm();
+	any = TRUE;
+    }
+    if (all || !strcmp(which, "path")) {
+	BenchPath();
+	any = TRUE;
+    }
+    if (all || !strcmp(which, "mixed")) {
+	for (int threads = 1; threads <= 4; threads *= 2)
+	    BenchMixed(threads);
+	any = TRUE;
+    }
+    if (!any)
+	printf("Benchmark: unknown workload %s "
+	    "(seq, rand, storm, path, mixed or all)\n", which);
+}
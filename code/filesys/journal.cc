@@ -0,0 +1,462 @@
+// journal.cc
+//	Routines to keep a write-ahead journal of file system metadata.
+//
+//	Updates are collected in memory by the open ("running")
+//	transaction.  When enough operations have finished, or on Sync,
+//	the transaction commits: its blocks are written sequentially into
+//	the log, after a descriptor giving their home locations, and then
+//	a commit block is written.  Once the commit block is on disk, the
+//	transaction will survive a crash.
+//
+//	Committed blocks are kept in memory, and written to their home
+//	locations by a background thread once the log is half full (or
+//	synchronously, if a commit does not fit in the log).  After that
+//	the journal superblock is updated to say the log is empty.
+//
+//	At boot, Replay walks the log from the tail recorded in the
+//	superblock, applying every transaction whose commit block is
+//	present, and stops at the first one that is incomplete.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+#define JournalMagic		0x4a524e4c	// Marks each kind of
+#define DescriptorMagic		0x4a444553	//   journal block
+#define CommitMagic		0x4a434d54
+
+// Dummy function because C++ can't fork a member function
+static void
+JournalCheckpointer(int arg)
+{
+    ((Journal *)arg)->CheckpointThread();
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal, and start the checkpoint thread.
+//
+//	If the disk is being formatted, the log is empty.  Otherwise,
+//	replay whatever committed transactions the last run left in it.
+//	Either way, transaction numbers continue past any stale records
+//	left in the log, so they can never be mistaken for new ones.
+//
+//	"format" -- is the disk being formatted?
+//----------------------------------------------------------------------
+
+Journal::Journal(bool format)
+{
+    char buf[SectorSize];
+    JournalSuper *super = (JournalSuper *)buf;
+
+    blocks = new JournalBlock *[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	blocks[i] = NULL;
+    running = new int[NumSectors];
+    spare = new int[NumSectors];
+    committed = new int[NumSectors];
+    numRunning = numCommitted = 0;
+    handles = numOps = 0;
+    commits = logWrites = homeWrites = replayed = 0;
+    used = 0;
+    lock = new Lock("journal lock");
+    wakeup = new Condition("journal checkpoint");
+    checkpointWanted = FALSE;
+
+    synchDisk->ReadSector(JournalSector, buf);
+    if (super->magic != JournalMagic) {
+	super->sequence = 1;
+	super->tail = 0;
+    } else if (format)
+	super->sequence += LogSize;
+
+    tail = head = super->tail;
+    tailSequence = sequence = super->sequence;
+    if (super->magic == JournalMagic && !format)
+	Replay();
+    WriteSuper();
+
+    Thread *t = new Thread("journal checkpoint");
+    t->Fork(JournalCheckpointer, (int)this);
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the in-memory journal state.  Updates that have not
+//	been committed are lost; Nachos syncs the file system before it
+//	halts (see SyncBeforeHalt), so there are none unless it crashed.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    for (int i = 0; i < NumSectors; i++)
+	delete blocks[i];
+    delete [] blocks;
+    delete [] running;
+    delete [] spare;
+    delete [] committed;
+    delete lock;
+    delete wakeup;
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	Apply the transactions left in the log, starting at the tail.
+//	Each is applied only if its commit block made it to disk; the
+//	first incomplete transaction marks the end of the log.
+//----------------------------------------------------------------------
+
+void
+Journal::Replay()
+{
+    char buf[SectorSize];
+    JournalDescriptor desc;
+    int *homes = new int[LogSize];
+    char *images = new char[LogSize * SectorSize];
+    int scanned = 0;
+
+    while (TRUE) {
+	int n = 0, pos = head, length = 0;
+	bool complete = FALSE;
+
+	while (scanned + length < LogSize) {
+	    synchDisk->ReadSector(LogStart + pos, buf);
+	    pos = (pos + 1) % LogSize;
+	    length++;
+	    JournalCommit *commit = (JournalCommit *)buf;
+	    if (commit->magic == CommitMagic && commit->sequence == sequence) {
+		complete = TRUE;
+		break;
+	    }
+	    bcopy(buf, (char *)&desc, sizeof(desc));
+	    if (desc.magic != DescriptorMagic || desc.sequence != sequence
+			|| desc.count < 0 || desc.count > DescriptorEntries)
+		break;
+	    for (int i = 0; i < desc.count && scanned + length < LogSize; i++) {
+		synchDisk->ReadSector(LogStart + pos, &images[n * SectorSize]);
+		homes[n++] = desc.sectors[i];
+		pos = (pos + 1) % LogSize;
+		length++;
+	    }
+	}
+	if (!complete)
+	    break;
+	for (int i = 0; i < n; i++)
+	    synchDisk->WriteSector(homes[i], &images[i * SectorSize]);
+	scanned += length;
+	head = pos;
+	sequence++;
+	replayed++;
+    }
+    DEBUG('f', "Journal: replayed %d transactions.\n", replayed);
+    tail = head;
+    tailSequence = sequence;
+    delete [] homes;
+    delete [] images;
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin/End
+// 	Bracket an operation whose updates must commit together.  When
+//	the last operation in progress ends, and enough operations have
+//	been collected, the transaction commits.
+//
+//	Operations are counted per thread: only a thread's outermost
+//	Begin/End count, so a thread preempted inside an operation cannot
+//	leave the count of another behind.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    if (currentThread->journalDepth++ > 0)
+	return;				// nested in an operation
+    if (handles == 0 && numRunning > LogSize / 2)
+	Commit();			// keep transactions well inside the log
+    handles++;
+    numOps++;
+}
+
+void
+Journal::End()
+{
+    ASSERT(currentThread->journalDepth > 0);
+    if (--currentThread->journalDepth > 0)
+	return;
+    if (--handles == 0
+		&& (numOps >= GroupCommitOps || numRunning > LogSize / 2))
+	Commit();
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadSector
+// 	Read the latest image of a sector: the one in the running
+//	transaction, or else the committed one not yet written home, or
+//	else the one on disk.
+//----------------------------------------------------------------------
+
+void
+Journal::ReadSector(int sector, char *data)
+{
+    JournalBlock *block = blocks[sector];
+
+    if (block != NULL && block->inRunning)
+	bcopy(block->running, data, SectorSize);
+    else if (block != NULL && block->inCommitted)
+	bcopy(block->committed, data, SectorSize);
+    else
+	synchDisk->ReadSector(sector, data);
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadSectors
+// 	Read the latest images of "count" consecutive sectors (a file
+//	system block).  If none of them is in the journal, they are read
+//	from disk in a single transfer.
+//----------------------------------------------------------------------
+
+void
+Journal::ReadSectors(int sector, char *data, int count)
+{
+    for (int i = 0; i < count; i++)
+	if (blocks[sector + i] != NULL) {
+	    for (i = 0; i < count; i++)
+		ReadSector(sector + i, data + i * SectorSize);
+	    return;
+	}
+    synchDisk->ReadSectors(sector, data, count);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSector
+// 	Record an update to a metadata sector in the running transaction.
+//	A sector updated several times before commit is logged only once.
+//	If no operation is in progress, the update is an operation on
+//	its own.  If the transaction is full, it commits first.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteSector(int sector, char *data)
+{
+    Begin();
+    while (numRunning >= MaxRunning
+		&& (blocks[sector] == NULL || !blocks[sector]->inRunning))
+	Commit(TRUE);			// no room in the log: split
+    JournalBlock *block = blocks[sector];
+    if (block == NULL) {
+	block = blocks[sector] = new JournalBlock;
+	block->inRunning = block->inCommitted = FALSE;
+    }
+    if (!block->inRunning) {
+	block->inRunning = TRUE;
+	running[numRunning++] = sector;
+    }
+    bcopy(data, block->running, SectorSize);
+    End();
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteData
+// 	Write "count" consecutive sectors of file data (a file system
+//	block), in a single transfer.  Data is not journaled, except when
+//	a sector still has metadata updates in the journal (it was freed
+//	and reused recently): the data then has to be logged after them,
+//	or a checkpoint or replay would overwrite it with the old metadata.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteData(int sector, char *data, int count)
+{
+    for (int i = 0; i < count; i++)
+	if (blocks[sector + i] != NULL) {
+	    for (i = 0; i < count; i++)
+		if (blocks[sector + i] != NULL)
+		    WriteSector(sector + i, data + i * SectorSize);
+		else
+		    synchDisk->WriteSector(sector + i, data + i * SectorSize);
+	    return;
+	}
+    synchDisk->WriteSectors(sector, data, count);
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the running transaction to the log: descriptor blocks, the
+//	blocks themselves, and a commit block.  The images become the
+//	committed images, waiting to be checkpointed; a new running
+//	transaction starts right away, so other threads can keep updating
+//	metadata while the log is being written.
+//
+//	Unless "split", the commit is put off if an operation began while
+//	we waited for the lock; the last one to end commits instead.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit(bool split)
+{
+    char buf[SectorSize];
+    int n, needed;
+
+    lock->Acquire();
+    while (TRUE) {
+	if (numRunning == 0 || (handles > 0 && !split)) {
+	    lock->Release();
+	    return;
+	}
+	n = numRunning;			// at most MaxRunning, so it fits
+	needed = n + divRoundUp(n, DescriptorEntries) + 1;
+	if (used + needed <= LogSize)
+	    break;
+	CheckpointLocked();		// no room: checkpoint right now
+    }
+
+    int *sectors = running;
+    int seq = sequence++;
+    running = spare;
+    spare = sectors;			// free again by the next commit
+    numRunning = numOps = 0;
+    for (int i = 0; i < n; i++) {
+	JournalBlock *block = blocks[sectors[i]];
+	bcopy(block->running, block->committed, SectorSize);
+	block->inRunning = FALSE;
+	if (!block->inCommitted) {
+	    block->inCommitted = TRUE;
+	    committed[numCommitted++] = sectors[i];
+	}
+    }
+
+    int pos = head;
+    for (int first = 0; first < n; first += DescriptorEntries) {
+	JournalDescriptor *desc = (JournalDescriptor *)buf;
+	bzero(buf, SectorSize);
+	desc->magic = DescriptorMagic;
+	desc->sequence = seq;
+	desc->count = n - first;
+	if (desc->count > DescriptorEntries)
+	    desc->count = DescriptorEntries;
+	for (int i = 0; i < desc->count; i++)
+	    desc->sectors[i] = sectors[first + i];
+	synchDisk->WriteSector(LogStart + pos, buf);
+	pos = (pos + 1) % LogSize;
+	for (int i = 0; i < desc->count; i++) {
+	    synchDisk->WriteSector(LogStart + pos,
+				blocks[sectors[first + i]]->committed);
+	    pos = (pos + 1) % LogSize;
+	}
+    }
+    JournalCommit *commit = (JournalCommit *)buf;
+    bzero(buf, SectorSize);
+    commit->magic = CommitMagic;
+    commit->sequence = seq;
+    synchDisk->WriteSector(LogStart + pos, buf);
+    head = (pos + 1) % LogSize;
+    used += needed;
+    commits++;
+    logWrites += needed;
+    DEBUG('f', "Journal: committed transaction %d, %d blocks.\n", seq, n);
+
+    if (used > LogSize / 2) {		// let the checkpoint thread catch up
+	checkpointWanted = TRUE;
+	wakeup->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Sync
+// 	Commit the running transaction, so everything done so far
+//	survives a crash.  If operations are in progress, the transaction
+//	commits as soon as the last of them ends.
+//----------------------------------------------------------------------
+
+void
+Journal::Sync()
+{
+    if (handles == 0)
+	Commit();
+    else
+	numOps = GroupCommitOps;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Commit, then write every committed block home and empty the log.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    Sync();
+    lock->Acquire();
+    CheckpointLocked();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CheckpointLocked
+// 	Write the committed blocks to their home locations; then every
+//	transaction in the log has been applied, so move the tail up to
+//	the head.  The caller holds the journal lock, so no commit can
+//	happen meanwhile.
+//----------------------------------------------------------------------
+
+void
+Journal::CheckpointLocked()
+{
+    for (int i = 0; i < numCommitted; i++) {
+	int sector = committed[i];
+	JournalBlock *block = blocks[sector];
+
+	synchDisk->WriteSector(sector, block->committed);
+	homeWrites++;
+	block->inCommitted = FALSE;
+	if (!block->inRunning) {
+	    delete block;
+	    blocks[sector] = NULL;
+	}
+    }
+    numCommitted = 0;
+    tail = head;
+    tailSequence = sequence;
+    used = 0;
+    WriteSuper();
+}
+
+//----------------------------------------------------------------------
+// Journal::CheckpointThread
+// 	Wait until a commit leaves the log half full, then checkpoint.
+//----------------------------------------------------------------------
+
+void
+Journal::CheckpointThread()
+{
+    lock->Acquire();
+    while (TRUE) {
+	while (!checkpointWanted)
+	    wakeup->Wait(lock);
+	checkpointWanted = FALSE;
+	CheckpointLocked();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSuper
+// 	Record the tail of the log in the journal superblock.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteSuper()
+{
+    char buf[SectorSize];
+    JournalSuper *super = (JournalSuper *)buf;
+
+    bzero(buf, SectorSize);
+    super->magic = JournalMagic;
+    super->sequence = tailSequence;
+    super->tail = tail;
+    synchDisk->WriteSector(JournalSector, buf);
+}
@@ -0,0 +1,159 @@
+// journal.h
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	Every update to file system metadata -- file headers, index blocks,
+//	directory contents and the bitmap of free sectors -- is made
+//	inside a transaction, and goes to the journal instead of straight
+//	to its home location on disk.  The updates are kept in memory
+//	until the transaction commits, at which point they are written,
+//	one after another, into a log region on disk, followed by a commit
+//	record.  Only later are they copied ("checkpointed") to their home
+//	locations, by a background thread.
+//
+//	If Nachos stops in the middle of an operation, the disk is left
+//	with either all or none of the operation's metadata updates: at
+//	the next boot, the committed transactions still in the log are
+//	replayed, and anything else is ignored.
+//
+//	Several operations are grouped into one transaction (group
+//	commit), so a burst of creates and removes costs one sequential
+//	log write, and a sector updated several times in a burst is only
+//	logged once.
+//
+//	A transaction never outgrows the log: once it holds MaxRunning
+//	sectors it commits, even in the middle of an operation.  Only an
+//	operation too big for the log on its own (or one running alongside
+//	others that fill it) loses its atomicity this way.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+
+// Location of the journal on disk.  The journal superblock is in a
+// well-known sector; the log is a fixed run of sectors after it, used
+// as a circular buffer.  The file system marks all of these in use
+// when the disk is formatted.
+#define JournalSector		3
+#define LogStart		4
+#define LogSize			128
+
+#define GroupCommitOps		8	// operations per transaction
+
+// On-disk journal superblock: where the oldest transaction that may
+// still need replaying starts in the log, and its sequence number.
+class JournalSuper {
+  public:
+    int magic;
+    int sequence;			// Sequence number of the transaction
+    int tail;				// Log position of that transaction
+};
+
+// On-disk log records.  A transaction is written as one or more
+// descriptor blocks, each followed by the blocks it describes, and
+// then a commit block.
+#define DescriptorEntries 	((int)(SectorSize / sizeof(int)) - 3)
+
+// Most sectors a transaction can hold, so that it fits in the log
+// with its descriptors and commit block
+#define MaxRunning	(LogSize - 1 - divRoundUp(LogSize, DescriptorEntries))
+
+class JournalDescriptor {
+  public:
+    int magic;
+    int sequence;			// Transaction this belongs to
+    int count;				// Number of blocks that follow
+    int sectors[DescriptorEntries];	// Home location of each block
+};
+
+class JournalCommit {
+  public:
+    int magic;
+    int sequence;			// Transaction that is now complete
+};
+
+// In-memory state of a sector with journaled updates.  "running" is
+// the latest image, changed by the open transaction; "committed" is
+// the image as of the last commit, which has not yet been written to
+// its home location.
+class JournalBlock {
+  public:
+    bool inRunning, inCommitted;
+    char running[SectorSize];
+    char committed[SectorSize];
+};
+
+// The following class defines the journal.  All file system reads go
+// through ReadSector, which sees updates not yet written home.  Writes
+// of metadata go through WriteSector; writes of file data go through
+// WriteData, which only needs the journal if the sector was recently
+// used for metadata.
+//
+// An operation that makes several related updates brackets them with
+// Begin/End, so that they commit together.  Begin/End nest within a
+// thread.
+
+class Journal {
+  public:
+    Journal(bool format);		// Initialize the journal; if not
+					// formatting, replay the log
+    ~Journal();
+
+    void Begin();			// Start an operation
+    void End();				// Finish an operation, committing
+					// the transaction if it is big enough
+
+    void ReadSector(int sector, char *data);	// Read the latest image
+    void ReadSectors(int sector, char *data, int count);
+						// ... of "count" sectors
+    void WriteSector(int sector, char *data);	// Log a metadata update
+    void WriteData(int sector, char *data, int count = 1);
+						// Write file data
+
+    void Sync();			// Commit the open transaction now
+    bool IsDirty() { return numRunning > 0; }
+					// Is there anything to commit?
+    void Checkpoint();			// Write committed updates home,
+					// and empty the log
+
+    void CheckpointThread();		// Body of the background thread
+
+    int commits, logWrites, homeWrites;	// Statistics
+    int replayed;			// Transactions replayed at boot
+
+  private:
+    void Replay();			// Apply committed transactions left
+					// in the log by the last run
+    void Commit(bool split = FALSE);	// Write the open transaction to
+					// the log; if "split", even with
+					// operations in progress
+    void CheckpointLocked();		// Checkpoint, with lock held
+    void WriteSuper();			// Record the log tail on disk
+
+    JournalBlock **blocks;		// Sectors with journaled updates
+    int *running;			// Sectors changed by the open
+    int numRunning;			//   transaction
+    int *spare;				// Array for the next one
+    int *committed;			// Sectors committed but not yet
+    int numCommitted;			//   written home
+
+    int handles;			// Threads with an operation in progress
+    int numOps;				// Operations in the open transaction
+    int sequence;			// Sequence number of the next commit
+    int tail, tailSequence;		// Oldest transaction in the log
+    int head;				// Where the next commit goes
+    int used;				// Log sectors in use
+
+    Lock *lock;				// Serializes commit and checkpoint
+    Condition *wakeup;			// Signals the checkpoint thread
+    bool checkpointWanted;
+};
+
+#endif // JOURNAL_H
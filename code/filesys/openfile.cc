@@ -5,7 +5,13 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  The headers are kept in a table
+//	indexed by header sector (openfile_table), shared by every OpenFile
+//	on the same file, and stay there after the last close, so opening
+//	the file again does not read the header off disk.  Only the
+//	MaxClosedHeaders most recently closed are kept, though; older ones
+//	are thrown away, so walking over many files does not fill memory
+//	with headers and their index blocks.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,34 +26,108 @@
 #include <strings.h>
 #endif
 
+#define MaxClosedHeaders	64	// headers kept after the last close
+
+// Headers in openfile_table that no OpenFile refers to, least recently
+// closed first.  All of them are clean: nothing is buffered, and the
+// header on disk is up to date.
+static IntrusiveList<FileHeader, &FileHeader::nextClosed> closedHeaders;
+static int numClosed = 0;
+
+// Take "hdr" off the closed list, if it is on it.  It may not be even
+// with no OpenFile left, while its last close is still writing it out.
+static void
+Unclose(FileHeader *hdr)
+{
+    FileHeader *prev = NULL, *h = closedHeaders.Front();
+
+    while (h != NULL && h != hdr) {
+        prev = h;
+        h = closedHeaders.Next(h);
+    }
+    if (h != NULL) {
+        closedHeaders.RemoveAfter(prev);
+        numClosed--;
+    }
+}
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory, unless it is there already.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    if(openfile_table[sector]) hdr = openfile_table[sector];
-    else openfile_table[sector] = hdr = new FileHeader;
+    hdr = openfile_table[sector];
+    if(hdr == NULL){
+        openfile_table[sector] = hdr = new FileHeader;
+        hdr->FetchFrom(sector);
+        hdr->cachedSector = sector;
+    }else if(hdr->refcount == 0) Unclose(hdr);
     hdr->refcount++;
     this->sector = sector;
-    hdr->FetchFrom(sector);
     seekPosition = 0;
+    pipe = NULL;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::OpenFile
+// 	Open one end of a pipe.  Reads and writes go straight to the
+//	pipe; there is no file header, and no position to seek to.
+//
+//	"p" -- the pipe
+//	"w" -- is this the end that is written to?
+//----------------------------------------------------------------------
+
+OpenFile::OpenFile(PipeBuffer *p, bool w)
+{
+    hdr = NULL;
+    sector = -1;
+    seekPosition = 0;
+    pipe = p;
+    writeEnd = w;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
-// 	Close a Nachos file, de-allocating any in-memory data structures.
+// 	Close a Nachos file.  On the last close, data still buffered is
+//	flushed, the file header is written back if it changed, and kept
+//	in memory for the next open, in place of the least recently closed
+//	one if there are too many -- unless the file has been removed, in
+//	which case it is thrown away.
+//
+//	Closing the last end of a pipe deletes the pipe.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile(){
+    if(pipe != NULL){
+        if(pipe->Close(writeEnd)) delete pipe;
+        return;
+    }
     if(--hdr->refcount == 0){
-        openfile_table[sector] = NULL;
-        hdr->WriteBack(sector);
-        delete hdr;
+        if(!hdr->removed && hdr->HasPending()){
+            hdr->lock->AcquireWrite();
+            hdr->Flush(sector);
+            hdr->lock->ReleaseWrite();
+        }
+        if(hdr->removed){
+            openfile_table[sector] = NULL;
+            delete hdr;
+            return;
+        }
+        if(hdr->dirty) hdr->WriteBack(sector);
+        if(hdr->refcount > 0) return;   // re-opened while we wrote
+        Unclose(hdr);                   // ... and closed again
+        closedHeaders.Append(hdr);
+        if(++numClosed > MaxClosedHeaders){
+            FileHeader *oldest = closedHeaders.Remove();
+            numClosed--;
+            openfile_table[oldest->cachedSector] = NULL;
+            delete oldest;
+        }
     }
 }
 
@@ -71,7 +151,8 @@ OpenFile::Seek(int position)
 //	Return the number of bytes actually written or read, and as a
 //	side effect, increment the current position within the file.
 //
-//	Implemented using the more primitive ReadAt/WriteAt.
+//	Implemented using the more primitive ReadAt/WriteAt; for a pipe,
+//	the bytes just go through the pipe.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -81,6 +162,8 @@ OpenFile::Seek(int position)
 int
 OpenFile::Read(char *into, int numBytes)
 {
+   if (pipe != NULL)
+	return pipe->Read(into, numBytes);
    int result = ReadAt(into, numBytes, seekPosition);
    seekPosition += result;
    return result;
@@ -89,6 +172,8 @@ OpenFile::Read(char *into, int numBytes)
 int
 OpenFile::Write(char *into, int numBytes)
 {
+   if (pipe != NULL)
+	return pipe->Write(into, numBytes);
    int result = WriteAt(into, numBytes, seekPosition);
    seekPosition += result;
    return result;
@@ -120,14 +205,24 @@ OpenFile::Write(char *into, int numBytes)
 //			read/written
 //----------------------------------------------------------------------
 
+// Readers share the header lock, so any number of threads can read the
+// same file at once; only writers need it exclusively.
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    bool selfcall=FALSE;
-    if(hdr->lock->isHeldByCurrentThread())selfcall=TRUE;
-    if(!selfcall)hdr->lock->Acquire();
+    hdr->lock->AcquireRead();
+    int result = ReadData(into, numBytes, position);
+    hdr->lock->ReleaseRead();
+    return result;
+}
+
+// ReadAt without taking the header lock; the caller holds it (either way)
+int
+OpenFile::ReadData(char *into, int numBytes, int position)
+{
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int blockSize = FileHeader::blockSize;
+    int i, firstBlock, lastBlock, numBlocks;
     char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
@@ -137,39 +232,65 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    firstBlock = divRoundDown(position, blockSize);
+    lastBlock = divRoundDown(position + numBytes - 1, blockSize);
+    numBlocks = 1 + lastBlock - firstBlock;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    // read in all the full and partial blocks that we need; of each
+    // block on disk, just the sectors holding the bytes we want, as one
+    // multi-sector transfer.  A block still buffered comes from its page,
+    // and a hole (never written, or written past the end of the file but
+    // not flushed) is zeros, without going to disk
+    buf = new char[numBlocks * blockSize];
+    for (i = firstBlock; i <= lastBlock; i++) {
+        FilePage *page = hdr->FindPage(i, FALSE);
+        int dataSector = hdr->BlockToSector(i);
+        char *block = &buf[(i - firstBlock) * blockSize];
+        if (page != NULL)
+            bcopy(page->data, block, blockSize);
+        else if (dataSector != 0) {
+            int start = i == firstBlock ? position - i * blockSize : 0;
+            int end = i == lastBlock ? position + numBytes - i * blockSize
+                                     : blockSize;
+            int first = start / SectorSize, last = (end - 1) / SectorSize;
+            journal->ReadSectors(dataSector + first, &block[first * SectorSize],
+                                 last - first + 1);
+        } else
+            bzero(block, blockSize);
+    }
 
     // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
+    bcopy(&buf[position - (firstBlock * blockSize)], into, numBytes);
     delete [] buf;
     hdr->UpdateVisitedTime();
-    if(!selfcall)hdr->lock->Release();
     return numBytes;
 }
 
+// Directory contents and the free sector bitmap are metadata, and are
+// written through the journal right away.  When the write extends the
+// file, the new size, the blocks allocated for it and the data all
+// belong to one journal operation.  Other files' data is buffered (cf.
+// WriteBuffered).
 int OpenFile::WriteAt(char *from, int numBytes, int position){
-    hdr->lock->Acquire();
+    if(!IsDir() && sector != FreeMapSector)
+        return WriteBuffered(from, numBytes, position);
+    hdr->lock->AcquireWrite();
+    journal->Begin();
     if(numBytes+position>hdr->FileLength()){
-        BitMap *freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(fileSystem->freeMapFile);
-        hdr->ExpandSize(freeMap, numBytes+position);
-        freeMap->WriteBack(fileSystem->freeMapFile);
+        hdr->ExpandSize(fileSystem->freeMap, numBytes+position);
+        hdr->WriteBack(sector);
+        fileSystem->freeMap->WriteDirty(fileSystem->freeMapFile);
     }
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
     bool firstAligned, lastAligned;
     char *buf;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position >= fileLength)) {
+        journal->End();
+        hdr->lock->ReleaseWrite();
 	return 0;				// check request
+    }
     if ((position + numBytes) > fileLength)
 	numBytes = fileLength - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
@@ -186,9 +307,9 @@ int OpenFile::WriteAt(char *from, int numBytes, int position){
 
 // read in first and last sector, if they are to be partially modified
     if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
+        ReadData(buf, SectorSize, firstSector * SectorSize);	
     if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
+        ReadData(&buf[(lastSector - firstSector) * SectorSize], 
 				SectorSize, lastSector * SectorSize);	
 
 // copy in the bytes we want to change 
@@ -196,11 +317,57 @@ int OpenFile::WriteAt(char *from, int numBytes, int position){
 
 // write modified sectors back
     for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
+        journal->WriteSector(hdr->ByteToSector(i * SectorSize), 
 					&buf[(i - firstSector) * SectorSize]);
     delete [] buf;
     hdr->UpdateModifiedTime();
-    hdr->lock->Release();
+    journal->End();
+    hdr->lock->ReleaseWrite();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteBuffered
+// 	Write to an ordinary file by copying into its buffered pages (cf.
+//	FileHeader::FindPage); nothing goes to disk yet, and no space is
+//	allocated.  Each block is read at most once, when it is first
+//	partially written, and written once, when the file is flushed: on
+//	the last close, on FileSystem::Sync, or here, once the file has
+//	too many pages buffered.
+//
+//	Space for new blocks is reserved as they are buffered; once the
+//	disk has none left, the write stops short.
+//----------------------------------------------------------------------
+
+int OpenFile::WriteBuffered(char *from, int numBytes, int position){
+    if (numBytes > (int)MaxFileSize - position)
+        numBytes = (int)MaxFileSize - position;
+    if ((numBytes <= 0) || (position < 0))
+        return 0;
+    DEBUG('f', "Buffering %d bytes at %d, file of length %d.\n",
+            numBytes, position, hdr->FileLength());
+    hdr->lock->AcquireWrite();
+    int done = 0;
+    while (done < numBytes) {
+        int block = (position + done) / FileHeader::blockSize;
+        int offset = (position + done) % FileHeader::blockSize;
+        int n = FileHeader::blockSize - offset;
+        if (n > numBytes - done)
+            n = numBytes - done;
+        FilePage *page = hdr->FindPage(block, TRUE);
+        if (page == NULL)
+            break;				// disk full
+        bcopy(from + done, &page->data[offset], n);
+        done += n;
+    }
+    numBytes = done;
+    if (numBytes > 0) {
+        hdr->ExtendPending(position + numBytes);
+        hdr->UpdateModifiedTime();
+    }
+    if (hdr->numPages > MaxBufferedPages)
+        hdr->Flush(sector);
+    hdr->lock->ReleaseWrite();
     return numBytes;
 }
 
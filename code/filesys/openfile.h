@@ -23,14 +23,21 @@
 #define OPENFILE_H
 
 #include "utility.h"
+#include "pipe.h"
 
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
 					// See definitions listed under #else
 class OpenFile {
   public:
-    OpenFile(int f) { file = f; currentOffset = 0; }	// open the file
-    ~OpenFile() { Close(file); }			// close the file
+    OpenFile(int f) { file = f; currentOffset = 0; pipe = NULL; }
+							// open the file
+    OpenFile(PipeBuffer *p, bool w) { pipe = p; writeEnd = w; }	// one end
+							// of a pipe
+    ~OpenFile() {					// close the file
+		if (pipe == NULL) Close(file);
+		else if (pipe->Close(writeEnd)) delete pipe;
+		}
 
     int ReadAt(char *into, int numBytes, int position) { 
     		Lseek(file, position, 0); 
@@ -42,11 +49,13 @@ class OpenFile {
 		return numBytes;
 		}	
     int Read(char *into, int numBytes) {
+		if (pipe != NULL) return pipe->Read(into, numBytes);
 		int numRead = ReadAt(into, numBytes, currentOffset); 
 		currentOffset += numRead;
 		return numRead;
     		}
     int Write(char *from, int numBytes) {
+		if (pipe != NULL) return pipe->Write(from, numBytes);
 		int numWritten = WriteAt(from, numBytes, currentOffset); 
 		currentOffset += numWritten;
 		return numWritten;
@@ -57,6 +66,8 @@ class OpenFile {
   private:
     int file;
     int currentOffset;
+    PipeBuffer *pipe;			// if not NULL, this is an end of
+    bool writeEnd;			//   "pipe", not a UNIX file
 };
 
 #else // FILESYS
@@ -66,6 +77,7 @@ class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
+    OpenFile(PipeBuffer *p, bool w);	// Open one end of a pipe
     ~OpenFile();			// Close the file
 
     void Seek(int position); 		// Set the position from which to 
@@ -92,9 +104,17 @@ class OpenFile {
 	int GetSector(){return sector;}
     
   private:
+    int ReadData(char *into, int numBytes, int position);
+					// ReadAt, with the header lock held
+    int WriteBuffered(char *from, int numBytes, int position);
+					// WriteAt for ordinary files: only
+					// fill in the buffered pages
+
     FileHeader *hdr;			// Header for this file 
 	int sector;                 // 文件头所在扇区号，方便写回
     int seekPosition;			// Current position within the file
+    PipeBuffer *pipe;			// If not NULL, this is an end of
+    bool writeEnd;			//   "pipe", not a file on disk
 };
 
 #endif // FILESYS
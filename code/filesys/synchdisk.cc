@@ -38,13 +38,15 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"tracks", "sectors" -- geometry to give the disk, or 0 to keep
+//	   the one recorded in the file
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int tracks, int sectors)
 {
     semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    disk = new Disk(name, DiskRequestDone, (int) this, tracks, sectors);
 }
 
 //----------------------------------------------------------------------
@@ -96,6 +98,40 @@ SynchDisk::WriteSector(int sectorNumber, char* data)
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write "count" consecutive sectors, holding the disk for the
+//	whole transfer, so that the head stays on the track and the
+//	sectors stream in one after another (as they do on a real disk
+//	for a multi-sector request).
+//
+//	"sectorNumber" -- the first sector
+//	"data" -- the buffer holding all of the sectors
+//	"count" -- how many sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, char* data, int count)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	disk->ReadRequest(sectorNumber + i, data + i * SectorSize);
+	semaphore->P();
+    }
+    lock->Release();
+}
+
+void
+SynchDisk::WriteSectors(int sectorNumber, char* data, int count)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	disk->WriteRequest(sectorNumber + i, data + i * SectorSize);
+	semaphore->P();
+    }
+    lock->Release();
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
 // 	Disk interrupt handler.  Wake up any thread waiting for the disk
@@ -107,3 +143,18 @@ SynchDisk::RequestDone()
 { 
     semaphore->V();
 }
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Make sure every write so far has reached the UNIX file behind
+//	the disk.  Costs no simulated time: a real disk's writes are
+//	durable once they complete.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    lock->Acquire();
+    disk->Sync();
+    lock->Release();
+}
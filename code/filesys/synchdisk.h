@@ -26,7 +26,8 @@
 // returning.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, int tracks = 0, int sectors = 0);
+					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
     
@@ -37,6 +38,13 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int sectorNumber, char* data, int count);
+    void WriteSectors(int sectorNumber, char* data, int count);
+					// Read/write "count" consecutive
+					// sectors as one transfer: no other
+					// request can come in between
+    void Sync();			// Make the writes so far durable
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
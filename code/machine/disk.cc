@@ -1,6 +1,8 @@
 // disk.cc 
 //	Routines to simulate a physical disk device; reading and writing
-//	to the disk is simulated as reading and writing to a UNIX file.
+//	to the disk is simulated as reading and writing to a UNIX file,
+//	mapped into memory so that a request is a copy rather than a
+//	pair of system calls.
 //	See disk.h for details about the behavior of disks (and
 //	therefore about the behavior of this simulation).
 //
@@ -19,11 +21,19 @@
 
 // We put this at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
-// as a disk (which would probably trash the file's contents).
-#define MagicNumber 	0x456789ab
+// as a disk (which would probably trash the file's contents).  The
+// geometry follows the magic number; files with the old magic number
+// have no geometry, and are always DefaultNumTracks by
+// DefaultSectorsPerTrack.
+#define MagicNumber 	0x456789ac
+#define OldMagicNumber 	0x456789ab
 #define MagicSize 	sizeof(int)
+#define HeaderSize 	(3 * sizeof(int))	// magic, tracks, sectors
 
-#define DiskSize 	(MagicSize + (NumSectors * SectorSize))
+#define DiskSize 	(headerSize + (NumSectors * SectorSize))
+
+int Disk::numTracks = DefaultNumTracks;
+int Disk::sectorsPerTrack = DefaultSectorsPerTrack;
 
 // dummy procedure because we can't take a pointer of a member function
 static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
@@ -32,17 +42,21 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's 
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  Then read the geometry,
+//	unless a new one was asked for.
 //
 //	"name" -- text name of the file simulating the Nachos disk
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
+//	"tracks", "sectors" -- the geometry to give the disk, or 0 to keep
+//	   the one it has (or the default, for a new disk)
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+	   int tracks, int sectors)
 {
-    int magicNum;
+    int header[3];
     int tmp = 0;
 
     DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg);
@@ -53,31 +67,74 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
     
     fileno = OpenForReadWrite(name, FALSE);
     if (fileno >= 0) {		 	// file exists, check magic number 
-	Read(fileno, (char *) &magicNum, MagicSize);
-	ASSERT(magicNum == MagicNumber);
+	Read(fileno, (char *) header, MagicSize);
+	if (header[0] == OldMagicNumber) {
+	    headerSize = MagicSize;
+	    numTracks = DefaultNumTracks;
+	    sectorsPerTrack = DefaultSectorsPerTrack;
+	} else {
+	    ASSERT(header[0] == MagicNumber);
+	    Read(fileno, (char *) &header[1], HeaderSize - MagicSize);
+	    headerSize = HeaderSize;
+	    numTracks = header[1];
+	    sectorsPerTrack = header[2];
+	}
+	if (tracks == 0 || (tracks == numTracks && sectors == sectorsPerTrack))
+	    tracks = 0;			// keep it as it is
     } else {				// file doesn't exist, create it
         fileno = OpenForWrite(name);
-	magicNum = MagicNumber;  
-	WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
+	if (tracks == 0) {
+	    tracks = DefaultNumTracks;
+	    sectors = DefaultSectorsPerTrack;
+	}
+    }
+
+    if (tracks != 0) {			// write a header with the new geometry
+	ASSERT(tracks > 0 && sectors > 0 && tracks * sectors <= MaxNumSectors);
+	numTracks = tracks;
+	sectorsPerTrack = sectors;
+	headerSize = HeaderSize;
+	header[0] = MagicNumber;
+	header[1] = tracks;
+	header[2] = sectors;
+	Lseek(fileno, 0, 0);
+	WriteFile(fileno, (char *) header, HeaderSize);
 
 	// need to write at end of file, so that reads will not return EOF
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    image = MapFile(fileno, DiskSize);
+    DEBUG('d', "Disk has %d tracks of %d sectors\n", numTracks, sectorsPerTrack);
     active = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
-// 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+// 	Clean up disk simulation, by flushing and closing the UNIX file
+//	representing the disk.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    Sync();
+    UnmapFile(image, DiskSize);
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Sync()
+// 	Make sure everything written to the disk so far is in the UNIX
+//	file.  Requests only change the mapped image of the file, which
+//	the host writes back when it likes.
+//----------------------------------------------------------------------
+
+void
+Disk::Sync()
+{
+    SyncMappedFile(image, DiskSize);
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -121,8 +178,7 @@ Disk::ReadRequest(int sectorNumber, char* data)
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
     
     DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    bcopy(image + headerSize + SectorSize * sectorNumber, data, SectorSize);
     if (DebugIsEnabled('d'))
 	PrintSector(FALSE, sectorNumber, data);
     
@@ -141,8 +197,7 @@ Disk::WriteRequest(int sectorNumber, char* data)
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
     
     DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    bcopy(data, image + headerSize + SectorSize * sectorNumber, SectorSize);
     if (DebugIsEnabled('d'))
 	PrintSector(TRUE, sectorNumber, data);
     
@@ -45,19 +45,35 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The geometry of the disk -- the number of tracks, and of sectors per
+// track -- is recorded at the front of the UNIX file, after the magic
+// number.  It is chosen when the file is created, or when the disk is
+// formatted with a new geometry; otherwise it is whatever the file says.
 
 #define SectorSize 		128	// number of bytes per disk sector
-#define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
+#define SectorsPerTrack 	(Disk::sectorsPerTrack)
+					// number of sectors per disk track 
+#define NumTracks 		(Disk::numTracks)
+					// number of tracks per disk
 #define NumSectors 		(SectorsPerTrack * NumTracks)
 					// total # of sectors per disk
 
+#define DefaultSectorsPerTrack	32	// geometry of a new disk, unless
+#define DefaultNumTracks	32	//   asked for otherwise
+#define MaxNumSectors		(1 << 22)	// keeps the UNIX file under 2GB
+
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
+    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+	 int tracks = 0, int sectors = 0);
     					// Create a simulated disk.  
 					// Invoke (*callWhenDone)(callArg) 
 					// every time a request completes.
+					// If "tracks" is not 0, the disk
+					// gets that many tracks of "sectors"
+					// sectors, and loses its contents
+					// if that changes its geometry.
     ~Disk();				// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
@@ -66,6 +82,8 @@ class Disk {
     					// the disk and return immediately.
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
+    void Sync();			// Flush the writes so far to the
+					// UNIX file
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
@@ -75,8 +93,13 @@ class Disk {
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
 
+    static int numTracks;		// Geometry of the disk
+    static int sectorsPerTrack;
+
   private:
     int fileno;				// UNIX file number for simulated disk 
+    int headerSize;			// Bytes before sector 0 in the file
+    char *image;			// The UNIX file, mapped into memory
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
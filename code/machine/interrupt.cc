@@ -48,6 +48,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    next = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -60,7 +61,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    nextDue = NeverDue;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -73,9 +74,10 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    while (!pending.IsEmpty())
+	delete pending.RemoveMin();
+    while (!spare.IsEmpty())
+	delete spare.Remove();
 }
 
 //----------------------------------------------------------------------
@@ -145,6 +147,11 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Since this happens once per user instruction, the usual case --
+//	no interrupt is due yet -- is kept to advancing the clock and
+//	comparing it with "nextDue".  User time is not counted here; it
+//	is whatever is left of the total (see Statistics::Print).
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -155,10 +162,10 @@ Interrupt::OneTick()
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
-    } else {					// USER_PROGRAM
+    } else					// USER_PROGRAM
 	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
-    }
+    if (stats->totalTicks < nextDue)	// nothing to do yet
+	return;
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
 // check any pending interrupts are now ready to fire
@@ -167,12 +174,16 @@ Interrupt::OneTick()
 					// interrupts disabled)
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
+    if (abortRequested) {		// ctl-C: write out and halt
+	abortRequested = FALSE;
+	SyncBeforeHalt(TRUE);
+    }
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
     if (yieldOnReturn) {		// if the timer device handler asked 
 					// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
-	currentThread->Yield();
+	currentThread->Preempt();
     // currentThread->Suspend();
 	status = old;
     }
@@ -212,6 +223,13 @@ Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    if (abortRequested) {		// ctl-C: write out and halt
+	abortRequested = FALSE;
+	if (SyncBeforeHalt(TRUE)) {
+	    status = SystemMode;
+	    return;
+	}
+    }
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -226,7 +244,13 @@ Interrupt::Idle()
     // queue, it is time to stop.   If the console or the network is 
     // operating, there are *always* pending interrupts, so this code
     // is not reached.  Instead, the halt must be invoked by the user program.
+    // Before stopping, whatever the file system has not yet written
+    // out gets written.
 
+    if (SyncBeforeHalt(FALSE)) {
+	status = SystemMode;
+	return;				// the sync thread is now runnable
+    }
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
     printf("Assuming the program completed.\n");
@@ -250,7 +274,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it in a heap ordered by time.  The record for
+//	the interrupt is one that has already fired, if there is one.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -265,13 +290,24 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = spare.Remove();
+
+    if (toOccur == NULL)
+	toOccur = new PendingInterrupt(handler, arg, when, type);
+    else {
+	toOccur->handler = handler;
+	toOccur->arg = arg;
+	toOccur->when = when;
+	toOccur->type = type;
+    }
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending.Insert(toOccur);
+    if (when < nextDue)
+	nextDue = when;
 }
 
 //----------------------------------------------------------------------
@@ -297,26 +333,25 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending.Min();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet, leave it
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& pending.NumItems() == 1)
 	 return FALSE;
-    }
+
+    pending.RemoveMin();
+    nextDue = pending.IsEmpty() ? NeverDue : pending.Min()->when;
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -331,7 +366,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    spare.Prepend(toOccur);
     return TRUE;
 }
 
@@ -342,10 +377,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
 }
@@ -363,7 +396,8 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    for (int i = 0; i < pending.NumItems(); i++)	// in heap order
+	PrintPending(pending.Item(i));
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -67,8 +67,17 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned order;		// Order of scheduling, among interrupts
+				// at the same time
+    PendingInterrupt *next;	// Next interrupt on the spare list
 };
 
+#define NeverDue	0x7fffffff	// later than any interrupt
+
+typedef HeapQueue<PendingInterrupt, &PendingInterrupt::when,
+		  &PendingInterrupt::order> PendingList;
+typedef IntrusiveList<PendingInterrupt, &PendingInterrupt::next> SpareList;
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -114,8 +123,12 @@ class Interrupt {
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingList pending;	// the interrupts scheduled to occur in
+				// the future, soonest first
+    SpareList spare;		// interrupts that have fired, kept for
+				// re-use so Schedule need not allocate
+    int nextDue;		// when the soonest pending interrupt is
+				// due, or NeverDue if there is none
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -22,6 +22,33 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numDispatches = readyWaitTicks = maxReadyWait = numShares = 0;
+    shareSum = shareSquares = 0;
+    for (int i = 0; i < LatencyBuckets; i++)
+	readyLatency[i] = 0;
+    hostStart = WallTime();
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordReadyWait
+// 	Count a thread dispatched after waiting "ticks" on the ready
+//	list, in the histogram as well as the totals.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordReadyWait(int ticks)
+{
+    numDispatches++;
+    readyWaitTicks += ticks;
+    if (ticks > maxReadyWait)
+	maxReadyWait = ticks;
+
+    int bucket = 0;			// 1 + log2(ticks), rounded down
+    while (ticks > 0 && bucket < LatencyBuckets - 1) {
+	ticks >>= 1;
+	bucket++;
+    }
+    readyLatency[bucket]++;
 }
 
 //----------------------------------------------------------------------
@@ -33,8 +60,25 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
+    userTicks = totalTicks - idleTicks - systemTicks;
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
+    if (userTicks > 0)
+	printf("Host time: %.3f seconds, %.1f ns per user instruction\n",
+	    WallTime() - hostStart,
+	    (WallTime() - hostStart) * 1e9 / (userTicks / UserTick));
+    if (numDispatches > 0)
+	printf("Scheduling: dispatches %d, ready wait avg %d max %d\n",
+	    numDispatches, readyWaitTicks / numDispatches, maxReadyWait);
+    for (int i = 0; i < LatencyBuckets - 1; i++)
+	if (readyLatency[i] > 0)
+	    printf("  ready wait <  %8d ticks: %d\n", 1 << i, readyLatency[i]);
+    if (readyLatency[LatencyBuckets - 1] > 0)
+	printf("  ready wait >= %8d ticks: %d\n", 1 << (LatencyBuckets - 2),
+	    readyLatency[LatencyBuckets - 1]);
+    if (numShares > 0 && shareSquares > 0)	// Jain's fairness index
+	printf("Fairness: %d threads, index %.3f\n", numShares,
+	    shareSum * shareSum / (numShares * shareSquares));
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
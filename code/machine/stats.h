@@ -19,6 +19,8 @@
 //
 // The fields in this class are public to make it easier to update.
 
+#define LatencyBuckets	24
+
 class Statistics {
   public:
     int totalTicks;      	// Total time running Nachos
@@ -26,7 +28,9 @@ class Statistics {
     int systemTicks;	 	// Time spent executing system code
     int userTicks;       	// Time spent executing user code
 				// (this is also equal to # of
-				// user instructions executed)
+				// user instructions executed);
+				// only worked out by Print, as
+				// the time not accounted for above
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
@@ -36,8 +40,22 @@ class Statistics {
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
+    int numDispatches;		// number of threads put onto the CPU
+    int readyWaitTicks;		// total time they waited on the ready list
+    int maxReadyWait;		// longest time one of them waited
+    int readyLatency[LatencyBuckets];	// how many waited 0 ticks, 1,
+				// 2-3, 4-7, ... (the last bucket
+				// takes everything longer)
+    double shareSum;		// CPU share of each finished thread,
+    double shareSquares;	// relative to its weight: sum and sum
+    int numShares;		// of squares, for the fairness index
+
+    double hostStart;		// host time when Nachos started, in seconds
+
     Statistics(); 		// initialize everything to zero
 
+    void RecordReadyWait(int ticks);	// a thread waited "ticks" on
+				// the ready list before running
     void Print();		// print collected statistics
 };
 
@@ -254,6 +254,47 @@ Close(int fd)
     ASSERT(retVal >= 0); 
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "size" bytes of an open file into memory, shared
+//	with the file, so that stores into the memory change the file.
+//	Abort on error.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int size)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(ptr != MAP_FAILED);
+    return (char *) ptr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Write the changes made to a mapped file back to the file, and
+//	wait for them to reach the disk.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *ptr, int size)
+{
+    int retVal = msync(ptr, size, MS_SYNC);
+    ASSERT(retVal >= 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile.  Changes not yet synced still reach the file
+//	eventually.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *ptr, int size)
+{
+    int retVal = munmap(ptr, size);
+    ASSERT(retVal >= 0);
+}
+
 //----------------------------------------------------------------------
 // Unlink
 // 	Delete a file.
@@ -416,6 +457,21 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// WallTime
+// 	Return the time of day on the host, in seconds, for measuring how
+//	long something really took (as opposed to simulated time).
+//----------------------------------------------------------------------
+
+double 
+WallTime()
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -27,6 +27,12 @@ extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
+
+// Map an open UNIX file into memory, so it can be read and written
+// in place; flush the changes to the file, and unmap it
+extern char *MapFile(int fd, int size);
+extern void SyncMappedFile(char *ptr, int size);
+extern void UnmapFile(char *ptr, int size);
 extern bool Unlink(char *name);
 
 // Interprocess communication operations, for simulating the network
@@ -43,6 +49,9 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Host time of day, in seconds -- for timing the simulation itself
+extern double WallTime();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
@@ -0,0 +1,26 @@
+/* pipe.c
+ *	Simple program to test pipes.
+ *
+ *	A forked thread writes a message into a pipe, and the main
+ *	thread reads it back out, then exits with its first character.
+ */
+
+#include "syscall.h"
+
+char str[] = "hello pipe!";
+char buffer[256];
+OpenFileId fds[2];
+
+void producer(){
+    Write(str, 12, fds[1]);
+    Close(fds[1]);
+    Exit(0);
+}
+
+int main() {
+    Pipe(fds);
+    Fork(producer);
+    Read(buffer, 12, fds[0]);
+    Close(fds[0]);
+    Exit((int)buffer[0]);
+}
@@ -74,6 +74,14 @@ Join:
 	j	$31
 	.end Join
 
+	.globl Share
+	.ent	Share
+Share:
+	addiu $2,$0,SC_Share
+	syscall
+	j	$31
+	.end Share
+
 	.globl Create
 	.ent	Create
 Create:
@@ -178,6 +186,14 @@ Remove:
 	j	$31
 	.end Remove
 
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -18,6 +18,8 @@
 #include "copyright.h"
 #include "list.h"
 
+int ListElement::numAllocated = 0;
+
 //----------------------------------------------------------------------
 // ListElement::ListElement
 // 	Initialize a list element, so it can be added somewhere on a list.
@@ -32,6 +34,7 @@ ListElement::ListElement(void *itemPtr, int sortKey)
      item = itemPtr;
      key = sortKey;
      next = NULL;	// assume we'll put it at the end of the list 
+     numAllocated++;
 }
 
 //----------------------------------------------------------------------
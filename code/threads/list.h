@@ -6,6 +6,11 @@
 //	pending interrupts, etc.  That is why each item is a "void *",
 //	or in other words, a "pointers to anything".
 //
+//	The kernel's own queues -- of ready threads, of threads waiting
+//	on a synchronization variable, and of pending interrupts -- use
+//	the intrusive lists and heaps at the end of this file instead, so
+//	that queueing does not allocate.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -28,6 +33,10 @@ class ListElement {
    public:
      ListElement(void *itemPtr, int sortKey);	// initialize a list element
 
+     static int numAllocated;	// list elements made so far -- for
+				// checking that a path through the
+				// kernel does not allocate them
+
      ListElement *next;		// next element on list, 
 				// NULL if this is the last
      int key;		    	// priority, for a sorted list
@@ -65,4 +74,179 @@ class List {
     ListElement *last;		// Last element of list
 };
 
+// The following classes define lists whose items are linked through a
+// field inside the items themselves, instead of through ListElements,
+// so that putting an item on a list, or taking it off, never allocates
+// memory.  "Link" is the member of T that points to the next item; an
+// item can only be on one list at a time through a given link.
+//
+// An IntrusiveList is a FIFO queue.
+
+template <class T, T *T::*Link>
+class IntrusiveList {
+  public:
+    IntrusiveList() { first = last = NULL; }
+
+    void Prepend(T *item);	// Put item at the beginning of the list
+    void Append(T *item);	// Put item at the end of the list
+    T *Remove();		// Take item off the front of the list,
+				// NULL if the list is empty
+    T *RemoveAfter(T *prev);	// Take the item after "prev" off the
+				// list (the front, if "prev" is NULL)
+
+    bool IsEmpty() { return first == NULL; }
+    T *Front() { return first; }
+    static T *Next(T *item) { return item->*Link; }
+				// For walking the list
+
+  private:
+    T *first;			// Head of the list, NULL if list is empty
+    T *last;			// Last item on the list
+};
+
+// A HeapQueue is a priority queue, kept as a binary heap of pointers
+// to its items: the item with the smallest "Key" can be looked at in
+// constant time, and added or removed in logarithmic time.  Items with
+// equal keys come off in the order they were put on; "Order" is the
+// member of T where the queue keeps the sequence number that ensures
+// that.  The array of pointers only grows, so once it is big enough
+// the queue does not allocate.
+
+template <class T, int T::*Key, unsigned T::*Order>
+class HeapQueue {
+  public:
+    HeapQueue();
+    ~HeapQueue() { delete [] heap; }
+
+    void Insert(T *item);	// Put item into the queue
+    T *RemoveMin();		// Take the item with the smallest key
+				// out of the queue, NULL if it is empty
+    T *Min() { return numItems > 0 ? heap[0] : NULL; }
+				// ... or just look at it
+
+    bool IsEmpty() { return numItems == 0; }
+    int NumItems() { return numItems; }
+    T *Item(int i) { return heap[i]; }	// The items, in no particular 
+				// order, for 0 <= i < NumItems()
+
+  private:
+    bool Before(T *a, T *b)	// Should "a" come off before "b"?
+	{ return a->*Key < b->*Key || 
+		 (a->*Key == b->*Key && (int)(a->*Order - b->*Order) < 0); }
+
+    T **heap;			// heap[(i-1)/2] comes before heap[i]
+    int numItems;		// Items in the queue
+    int capacity;		// Size of "heap"
+    unsigned sequence;		// Sequence number of the next Insert
+};
+
+template <class T, T *T::*Link>
+void
+IntrusiveList<T, Link>::Prepend(T *item)
+{
+    item->*Link = first;
+    if (first == NULL)
+	last = item;
+    first = item;
+}
+
+template <class T, T *T::*Link>
+void
+IntrusiveList<T, Link>::Append(T *item)
+{
+    item->*Link = NULL;
+    if (first == NULL)
+	first = item;
+    else
+	last->*Link = item;
+    last = item;
+}
+
+template <class T, T *T::*Link>
+T *
+IntrusiveList<T, Link>::Remove()
+{
+    T *item = first;
+
+    if (item != NULL) {
+	first = item->*Link;
+	if (first == NULL)
+	    last = NULL;
+	item->*Link = NULL;
+    }
+    return item;
+}
+
+template <class T, T *T::*Link>
+T *
+IntrusiveList<T, Link>::RemoveAfter(T *prev)
+{
+    if (prev == NULL)
+	return Remove();
+
+    T *item = prev->*Link;
+
+    if (item != NULL) {
+	prev->*Link = item->*Link;
+	if (last == item)
+	    last = prev;
+	item->*Link = NULL;
+    }
+    return item;
+}
+
+template <class T, int T::*Key, unsigned T::*Order>
+HeapQueue<T, Key, Order>::HeapQueue()
+{
+    capacity = 16;
+    heap = new T *[capacity];
+    numItems = 0;
+    sequence = 0;
+}
+
+template <class T, int T::*Key, unsigned T::*Order>
+void
+HeapQueue<T, Key, Order>::Insert(T *item)
+{
+    if (numItems == capacity) {		// make room
+	T **bigger = new T *[capacity * 2];
+	for (int i = 0; i < numItems; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	capacity *= 2;
+    }
+    item->*Order = sequence++;
+
+    int i = numItems++;			// sift up from the bottom
+    while (i > 0 && Before(item, heap[(i - 1) / 2])) {
+	heap[i] = heap[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    heap[i] = item;
+}
+
+template <class T, int T::*Key, unsigned T::*Order>
+T *
+HeapQueue<T, Key, Order>::RemoveMin()
+{
+    if (numItems == 0)
+	return NULL;
+
+    T *min = heap[0];
+    T *item = heap[--numItems];		// sift the last item down from
+    int i = 0;				// the top
+    while (2 * i + 1 < numItems) {
+	int child = 2 * i + 1;
+	if (child + 1 < numItems && Before(heap[child + 1], heap[child]))
+	    child++;
+	if (!Before(heap[child], item))
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = item;
+    return min;
+}
+
 #endif // LIST_H
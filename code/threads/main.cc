@@ -8,16 +8,27 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -sched <policy>
+//		-stacks <stacks kept>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-f -bs <block size> -geom <tracks> <sectors per track>
+//		-cp <unix file> <nachos file>
+//		-p <nachos file> -r <nachos file> -l -D -fsck -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
-//              -z
+//              -q <test number> -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -sched chooses how threads are scheduled: fifo, rr (round robin),
+//	priority, mlfq (multi-level feedback, the default), cfs
+//	("completely fair", by virtual runtime), stride or lottery (by
+//	tickets); the timer runs unless the policy is fifo
+//    -stacks sets how many stacks of finished threads are kept for new
+//	threads to re-use (default 64; 0 frees every one)
+//    -q runs a thread test (cf. threadtest.cc); 9 compares schedulers,
+//	10 measures proportional shares, 11 times fork and finish, 12
+//	runs 20000 threads at once
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
@@ -27,12 +38,26 @@
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -bs sets the size of file blocks when formatting (default 128 bytes)
+//    -geom sets the geometry of the disk when formatting (default 32 x 32;
+//	an existing DISK keeps the geometry it was formatted with)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -fsck checks the file system for leaked and doubly used sectors,
+//	and reports on fragmentation and directory fill
 //    -t tests the performance of the Nachos file system
+//    -tn tests path lookups through the name cache
+//    -tj tests batching of metadata updates by the journal
+//    -tjc (then -tjr, in a second run) tests replay after a crash
+//    -tc <n> (-tcw <n>) times n concurrent readers (and a writer) of a file
+//    -pt times a pipe between two threads
+//    -ts tests that files with holes only use space where written
+//    -td tests that writing a file until the disk is full fails cleanly
+//    -bench <workload> runs the file system benchmark (see fstest.cc);
+//	the workload is seq, rand, storm, path, mixed or all
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -60,7 +85,10 @@ extern int testnum;
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
-extern void Print(char *file), PerformanceTest(void), MultiThreadTest(void), RemoveTest(void), PipeTest(void);
+extern void Print(char *file), PerformanceTest(void), MultiThreadTest(void), RemoveTest(void), PipeTest(void), PathTest(void), JournalTest(void);
+extern void JournalCrashTest(void), JournalReplayTest(void);
+extern void ConcurrentReadTest(int readers, bool withWriter), Benchmark(char *which), SparseTest(void);
+extern void DiskFullTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out), SynchConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 
@@ -107,6 +135,14 @@ main(int argc, char **argv)
 		argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
             printf (copyright);
+#ifdef THREADS
+        if (!strcmp(*argv, "-q")) {		// run a thread test
+	    ASSERT(argc > 1);
+	    testnum = atoi(*(argv + 1));
+	    ThreadTest();
+	    argCount = 2;
+	}
+#endif
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {        	// run a user program
 	    	ASSERT(argc > 1);
@@ -161,14 +197,40 @@ main(int argc, char **argv)
 				fileSystem->List();
 		} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
 				fileSystem->Print();
+		} else if (!strcmp(*argv, "-fsck")) {	// check the file system
+				fileSystem->Check();
 		} else if (!strcmp(*argv, "-t")) {	// performance test
 				PerformanceTest();
 		} else if (!strcmp(*argv, "-tm")) {	
 				MultiThreadTest();
 		} else if (!strcmp(*argv, "-tr")) {
 				RemoveTest();
-		} else if (!strcmp(*argv, "-pt")) {
+		} else if (!strcmp(*argv, "-pt")) {	// pipe throughput
 				PipeTest();
+		} else if (!strcmp(*argv, "-tn")) {	// path lookup test
+				PathTest();
+		} else if (!strcmp(*argv, "-tj")) {	// journal test
+				JournalTest();
+		} else if (!strcmp(*argv, "-tjc")) {	// crash, for -tjr
+				JournalCrashTest();
+		} else if (!strcmp(*argv, "-tjr")) {	// replay after -tjc
+				JournalReplayTest();
+		} else if (!strcmp(*argv, "-tc")) {	// concurrent readers
+			ASSERT(argc > 1);
+			ConcurrentReadTest(atoi(*(argv + 1)), FALSE);
+			argCount = 2;
+		} else if (!strcmp(*argv, "-tcw")) {	// readers and a writer
+			ASSERT(argc > 1);
+			ConcurrentReadTest(atoi(*(argv + 1)), TRUE);
+			argCount = 2;
+		} else if (!strcmp(*argv, "-ts")) {	// sparse files
+				SparseTest();
+		} else if (!strcmp(*argv, "-td")) {	// disk full
+				DiskFullTest();
+		} else if (!strcmp(*argv, "-bench")) {	// benchmark
+			ASSERT(argc > 1);
+			Benchmark(*(argv + 1));
+			argCount = 2;
 		}
 #endif // FILESYS
 #ifdef NETWORK
@@ -182,6 +244,9 @@ main(int argc, char **argv)
         }
 #endif // NETWORK
     }
+#ifdef FILESYS
+    fileSystem->Sync();		// commit what the flags did to the disk
+#endif
 
     currentThread->Finish();	// NOTE: if the procedure "main" 
 				// returns, then the program "nachos"
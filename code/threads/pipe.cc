@@ -0,0 +1,142 @@
+// pipe.cc 
+//	Routines to move bytes through a pipe.
+//
+// 	Implemented in "monitor"-style -- surround each procedure with a
+// 	lock acquire and release pair, using condition signal and wait for
+// 	synchronization.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pipe.h"
+#include "synch.h"
+
+//----------------------------------------------------------------------
+// PipeBuffer::PipeBuffer
+//	Initialize an empty pipe, with both ends open.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+PipeBuffer::PipeBuffer(char *debugName)
+{
+    name = debugName;
+    buffer = new char[PipeSize];
+    head = count = 0;
+    readerOpen = writerOpen = TRUE;
+    lock = new Lock("pipe lock");
+    notEmpty = new Condition("pipe not empty");
+    notFull = new Condition("pipe not full");
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::~PipeBuffer
+//	De-allocate a pipe, and whatever was left in it.
+//----------------------------------------------------------------------
+
+PipeBuffer::~PipeBuffer()
+{
+    delete [] buffer;
+    delete lock;
+    delete notEmpty;
+    delete notFull;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Read
+//	Read up to "numBytes" bytes out of the pipe.  Wait until at least
+//	one byte is there, unless the write end is closed.  Wake up any
+//	writer waiting for room.  Return the number of bytes read; 0 means
+//	end of file.
+//
+//	"into" -- the buffer to hold the bytes read
+//	"numBytes" -- the most bytes to read
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Read(char *into, int numBytes)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (count == 0 && writerOpen)
+	notEmpty->Wait(lock);
+    while (done < numBytes && count > 0) {
+	int chunk = PipeSize - head;		// bytes up to the wrap point
+	if (chunk > count) chunk = count;
+	if (chunk > numBytes - done) chunk = numBytes - done;
+	bcopy(buffer + head, into + done, chunk);
+	head = (head + chunk) % PipeSize;
+	count -= chunk;
+	done += chunk;
+    }
+    if (done > 0)
+	notFull->Broadcast(lock);
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Write
+//	Write "numBytes" bytes into the pipe, waiting for room whenever
+//	it is full.  Wake up any reader waiting for bytes.  Return the
+//	number of bytes written, which is less than "numBytes" only if the
+//	read end has been closed.
+//
+//	"from" -- the bytes to write
+//	"numBytes" -- how many of them
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Write(char *from, int numBytes)
+{
+    int done = 0;
+
+    lock->Acquire();
+    while (done < numBytes && readerOpen) {
+	if (count == PipeSize) {
+	    notFull->Wait(lock);
+	    continue;
+	}
+	int tail = (head + count) % PipeSize;
+	int chunk = (tail >= head ? PipeSize : head) - tail;	// free bytes
+	if (chunk > numBytes - done) chunk = numBytes - done;	// before wrap
+	bcopy(from + done, buffer + tail, chunk);
+	count += chunk;
+	done += chunk;
+	notEmpty->Broadcast(lock);
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Close
+//	Close one end of the pipe, and wake up anyone waiting on the other
+//	end: a reader then sees end of file, and a writer gives up.
+//	Return TRUE if both ends are now closed, so the pipe can be deleted.
+//
+//	"writeEnd" -- close the write end, rather than the read end?
+//----------------------------------------------------------------------
+
+bool
+PipeBuffer::Close(bool writeEnd)
+{
+    bool done;
+
+    lock->Acquire();
+    if (writeEnd) {
+	ASSERT(writerOpen);
+	writerOpen = FALSE;
+	notEmpty->Broadcast(lock);
+    } else {
+	ASSERT(readerOpen);
+	readerOpen = FALSE;
+	notFull->Broadcast(lock);
+    }
+    done = !readerOpen && !writerOpen;
+    lock->Release();
+    return done;
+}
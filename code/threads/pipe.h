@@ -0,0 +1,61 @@
+// pipe.h 
+//	Data structures for a pipe -- a one-way channel of bytes between
+//	a writer and a reader, in the style of UNIX pipes.
+//
+//	The bytes are kept in a bounded ring buffer in memory, so moving
+//	data through a pipe never touches the disk.  A reader waits while
+//	the pipe is empty, and a writer waits while it is full.
+//
+//	Implemented in "monitor"-style, like SynchList.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Lock;
+class Condition;
+
+#define PipeSize	4096		// bytes buffered in a pipe
+
+// The following class defines a pipe: the buffer shared by its two
+// ends, each of which is an OpenFile.  Each pipe has one read end and
+// one write end; once both are closed, the pipe can be deleted.
+//
+// Read returns as soon as some bytes are available, and 0 once the
+// pipe is empty and the write end is closed (end of file).  Write
+// returns once all of the bytes are in the buffer, or early, if the
+// read end is closed and no one will ever read them.
+
+class PipeBuffer {
+  public:
+    PipeBuffer(char *debugName);	// initialize an empty pipe
+    ~PipeBuffer();			// de-allocate the pipe
+
+    int Read(char *into, int numBytes);	// read up to "numBytes" bytes,
+					// waiting while the pipe is empty
+    int Write(char *from, int numBytes);// write "numBytes" bytes, waiting
+					// while the pipe is full
+
+    bool Close(bool writeEnd);		// close one end; return TRUE if
+					// both ends are now closed
+
+    char *getName() { return name; }
+
+  private:
+    char *name;				// useful for debugging
+    char *buffer;			// ring buffer of PipeSize bytes
+    int head;				// index of the oldest byte
+    int count;				// number of bytes in the buffer
+    bool readerOpen, writerOpen;	// which ends are still open
+    Lock *lock;				// enforce mutual exclusive access
+    Condition *notEmpty;		// wait in Read if the pipe is empty
+    Condition *notFull;			// wait in Write if the pipe is full
+};
+
+#endif // PIPE_H
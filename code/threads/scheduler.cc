@@ -11,8 +11,10 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Which ready thread runs next is up to a scheduling policy, chosen
+//	with "-sched": fifo, rr, priority, mlfq (the default), cfs, stride
+//	or lottery.  The
+//	policies are at the end of this file.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,11 +27,13 @@
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
+//
+//	"p" decides which ready thread runs next.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(SchedPolicy *p)
 { 
-    readyList = new List; 
+    policy = p;
 } 
 
 //----------------------------------------------------------------------
@@ -39,7 +43,7 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    delete policy;
 } 
 
 //----------------------------------------------------------------------
@@ -55,9 +59,16 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    bool yielding = (thread == currentThread);
+
+    if (yielding)			// charge it for its run
+	Charge(thread);
     thread->setStatus(READY);
-    thread->resetTimeSlice();
-    readyList->SortedInsert((void *)thread, thread->getPriority());
+    thread->readySince = stats->totalTicks;
+    if (yielding)
+	policy->Yield(thread);
+    else
+	policy->Enqueue(thread);
 }
 
 //----------------------------------------------------------------------
@@ -71,13 +82,80 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->SortedRemove(NULL);
+    return policy->PickNext();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Tick
+// 	Called on each timer interrupt, with interrupts disabled, while
+//	a thread is running.  Charge the running thread for its time, and
+//	have it yield if the policy says so.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Tick()
+{
+    Charge(currentThread);
+    if (policy->Tick(currentThread))
+        interrupt->YieldOnReturn();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Weight
+// 	Return the weight of a thread at "priority": each level down
+//	gets about 4/5 the CPU of the level above it.
+//----------------------------------------------------------------------
+
+int
+Scheduler::Weight(int priority)
+{
+    static int weights[MaxPriority + 1];
+
+    if (weights[0] == 0) {
+	weights[0] = 1024;
+	for (int i = 1; i <= MaxPriority; i++) {
+	    weights[i] = weights[i - 1] * 4 / 5;
+	    if (weights[i] < 15)
+		weights[i] = 15;
+	}
+    }
+    return weights[priority];
 }
 
-int Scheduler::highestPriority(){
-    Thread *thread=(Thread *)readyList->front();
-    if (!thread) return 65536;
-    return thread->getPriority();
+//----------------------------------------------------------------------
+// Scheduler::Charge
+// 	Account for the ticks "thread" has run since it was dispatched or
+//	last charged, not counting any time the machine was idle while
+//	it slept: they are split between user and system time, and its
+//	virtual runtime grows by them, scaled down by its weight.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge(Thread *thread)
+{
+    int ran = stats->totalTicks - thread->runSince
+	- (stats->idleTicks - thread->idleSince);
+    int system = stats->systemTicks - thread->systemSince;
+
+    thread->vruntime += (long long) ran * 1024 / Weight(thread->getPriority());
+    thread->runTicks += ran;
+    thread->systemTicks += system;
+    thread->userTicks += ran - system;
+    StartClock(thread);
+    policy->Charge(thread, ran);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartClock
+// 	Start counting the time "thread" runs from now.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartClock(Thread *thread)
+{
+    thread->runSince = stats->totalTicks;
+    thread->systemSince = stats->systemTicks;
+    thread->idleSince = stats->idleTicks;
 }
 
 //----------------------------------------------------------------------
@@ -133,6 +211,25 @@ Scheduler::Run (Thread *nextThread)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    if (oldThread->getStatus() != READY)    // blocked or finishing;
+	Charge(oldThread);		    // ReadyToRun charged a yield
+    if (oldThread->preempted)
+	oldThread->involuntarySwitches++;
+    else
+	oldThread->voluntarySwitches++;
+    StartClock(nextThread);
+    int wait = stats->totalTicks - nextThread->readySince;
+    nextThread->readyWaitTicks += wait;
+    stats->RecordReadyWait(wait);
+    if (oldThread == threadToBeDestroyed) { // record its share of the CPU
+	double share = (double) oldThread->runTicks * 1024
+	    / Weight(oldThread->getPriority())
+	    / (stats->totalTicks - oldThread->createdAt + 1);
+	stats->shareSum += share;
+	stats->shareSquares += share * share;
+	stats->numShares++;
+    }
+
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
     
@@ -157,6 +254,454 @@ Scheduler::Run (Thread *nextThread)
 void
 Scheduler::Print()
 {
-    printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    printf("Ready list contents (%s):\n", policy->getName());
+    policy->Print();
+}
+
+//----------------------------------------------------------------------
+// NewSchedPolicy
+// 	Return a new scheduling policy, by name, or NULL if there is no
+//	policy by that name.
+//----------------------------------------------------------------------
+
+SchedPolicy *
+NewSchedPolicy(const char *name)
+{
+    if (!strcmp(name, "fifo"))
+	return new FifoPolicy();
+    if (!strcmp(name, "rr"))
+	return new RoundRobinPolicy();
+    if (!strcmp(name, "priority"))
+	return new PriorityPolicy();
+    if (!strcmp(name, "mlfq"))
+	return new MlfqPolicy();
+    if (!strcmp(name, "cfs"))
+	return new FairPolicy();
+    if (!strcmp(name, "stride"))
+	return new StridePolicy();
+    if (!strcmp(name, "lottery"))
+	return new LotteryPolicy();
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FifoPolicy
+// 	One queue, in the order threads became ready.
+//----------------------------------------------------------------------
+
+void
+FifoPolicy::Enqueue(Thread *thread)
+{
+    ready.Append(thread);
+}
+
+Thread *
+FifoPolicy::PickNext()
+{
+    return ready.Remove();
+}
+
+void
+FifoPolicy::Print()
+{
+    for (Thread *t = ready.Front(); t != NULL; t = ThreadQueue::Next(t))
+	t->Print();
+}
+
+//----------------------------------------------------------------------
+// RoundRobinPolicy
+// 	The FIFO queue, but each thread gets a fresh quantum when it is
+//	put on it, and yields once the quantum is used up.
+//----------------------------------------------------------------------
+
+void
+RoundRobinPolicy::Enqueue(Thread *thread)
+{
+    thread->setTimeSlice(RoundRobinQuantum);
+    FifoPolicy::Enqueue(thread);
+}
+
+bool
+RoundRobinPolicy::Tick(Thread *running)
+{
+    return !running->decreaseTimeSlice();
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::PriorityPolicy
+// 	Initialize the ready queues to empty.
+//----------------------------------------------------------------------
+
+PriorityPolicy::PriorityPolicy(const char *policyName)
+    : SchedPolicy(policyName)
+{
+    readyLevels = 0;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Enqueue
+// 	Put a thread at the back of the queue for its priority, with a
+//	fresh time slice.
+//----------------------------------------------------------------------
+
+void
+PriorityPolicy::Enqueue(Thread *thread)
+{
+    thread->resetTimeSlice();
+
+    int level = thread->getPriority();
+    readyList[level].Append(thread);
+    readyLevels |= 1u << level;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::PickNext
+// 	Take the first thread off the highest priority non-empty queue,
+//	or return NULL if no thread is ready.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityPolicy::PickNext()
+{
+    if (readyLevels == 0)
+	return NULL;
+    int level = __builtin_ctz(readyLevels);	// first non-empty queue
+    Thread *thread = readyList[level].Remove();
+    if (readyList[level].IsEmpty())
+	readyLevels &= ~(1u << level);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::highestPriority
+// 	Return the priority of the thread PickNext would return, or
+//	a number larger than any priority if no thread is ready.
+//----------------------------------------------------------------------
+
+int
+PriorityPolicy::highestPriority()
+{
+    if (readyLevels == 0) return 65536;
+    return __builtin_ctz(readyLevels);
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Tick
+// 	Yield to a thread of higher priority, or, once the time slice is
+//	used up, to one of the same priority.
+//----------------------------------------------------------------------
+
+bool
+PriorityPolicy::Tick(Thread *running)
+{
+    if (!running->decreaseTimeSlice())
+	return running->getPriority() >= highestPriority();
+    return running->getPriority() > highestPriority();
+}
+
+void
+PriorityPolicy::Print()
+{
+    for (int i = 0; i <= MaxPriority; i++)
+	for (Thread *t = readyList[i].Front(); t != NULL; t = ThreadQueue::Next(t))
+	    t->Print();
+}
+
+//----------------------------------------------------------------------
+// MlfqPolicy::Tick
+// 	When the running thread has used up its time slice, it drops a
+//	priority level and yields; it also yields to a thread of higher
+//	priority.
+//----------------------------------------------------------------------
+
+bool
+MlfqPolicy::Tick(Thread *running)
+{
+    if (!running->decreaseTimeSlice()) {
+        running->promotePriority(-1);
+        return TRUE;
+    }
+    return running->getPriority() > highestPriority();
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::FairPolicy
+// 	Initialize the heap of ready threads to empty.
+//----------------------------------------------------------------------
+
+FairPolicy::FairPolicy() : SchedPolicy("cfs")
+{
+    minVruntime = 0;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Enqueue
+// 	Put a new or woken thread in the heap, by virtual runtime.  It
+//	would otherwise be far behind the rest and monopolize the CPU
+//	until it caught up; it is moved up to just behind the thread
+//	that has run the least.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Enqueue(Thread *thread)
+{
+    if (thread->vruntime < minVruntime - FairGranularity)
+	thread->vruntime = minVruntime - FairGranularity;
+    ready.Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Yield
+// 	Put the running thread back in the heap, as is.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Yield(Thread *thread)
+{
+    ready.Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::PickNext
+// 	Take the thread with the least virtual runtime out of the heap.
+//----------------------------------------------------------------------
+
+Thread *
+FairPolicy::PickNext()
+{
+    if (ready.IsEmpty())
+	return NULL;
+    Thread *thread = ready.RemoveMin();
+    if (thread->vruntime > minVruntime)
+	minVruntime = thread->vruntime;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Tick
+// 	Preempt the running thread once it is more than FairGranularity
+//	ahead of the next thread in line.
+//
+//	Virtual runtimes only matter relative to each other, so before
+//	they can overflow, those of all threads are shifted down so that
+//	the least of the running and ready ones is 0; that leaves the heap
+//	in order.  A blocked thread that would go below -FairGranularity
+//	is left there, since Enqueue would move it up that far anyway.
+//	This is only safe here, when no thread is between the heap and
+//	the CPU.
+//----------------------------------------------------------------------
+
+bool
+FairPolicy::Tick(Thread *running)
+{
+    if (running->vruntime > FairRebase) {
+	int shift = running->vruntime;
+	if (!ready.IsEmpty() && ready.Min()->vruntime < shift)
+	    shift = ready.Min()->vruntime;
+	for (int i = 0; i < threadTable->NumSlots(); i++) {
+	    Thread *t = threadTable->InSlot(i);
+	    if (t == NULL)
+		continue;
+	    if (t == running || t->getStatus() == READY
+		    || t->vruntime - shift > -FairGranularity)
+		t->vruntime -= shift;
+	    else
+		t->vruntime = -FairGranularity;
+	}
+	minVruntime = minVruntime > shift ? minVruntime - shift : 0;
+    }
+    return !ready.IsEmpty()
+	&& running->vruntime > ready.Min()->vruntime + FairGranularity;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Print
+// 	Print the ready threads, in heap order.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Print()
+{
+    printf("(min vruntime %d)\n", minVruntime);
+    for (int i = 0; i < ready.NumItems(); i++)
+	ready.Item(i)->Print();
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::StridePolicy
+// 	Initialize the heap of ready threads to empty.
+//----------------------------------------------------------------------
+
+StridePolicy::StridePolicy() : SchedPolicy("stride")
+{
+    globalPass = 0;
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::Enqueue
+// 	Put a new or woken thread in the heap, at the current pass.
+//----------------------------------------------------------------------
+
+void
+StridePolicy::Enqueue(Thread *thread)
+{
+    thread->pass = globalPass;
+    ready.Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::Yield
+// 	Put the running thread back in the heap, at the pass it has
+//	reached.
+//----------------------------------------------------------------------
+
+void
+StridePolicy::Yield(Thread *thread)
+{
+    ready.Insert(thread);
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::PickNext
+// 	Take the thread with the lowest pass out of the heap.
+//----------------------------------------------------------------------
+
+Thread *
+StridePolicy::PickNext()
+{
+    if (ready.IsEmpty())
+	return NULL;
+    Thread *thread = ready.RemoveMin();
+    globalPass = thread->pass;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::Tick
+// 	Preempt the running thread once its pass is beyond that of the
+//	next thread in line.
+//
+//	Passes only matter relative to each other, so before they can
+//	overflow, those of the running and ready threads -- the only ones
+//	that are not reset when they are next put on the heap -- are all
+//	shifted down so that the least of them is 0; that leaves the heap
+//	in order.  The global pass may be older than all of them (the
+//	running thread may have run alone since it was picked), so it
+//	stops at 0.  This is only safe here, when no thread is between
+//	the heap and the CPU.
+//----------------------------------------------------------------------
+
+bool
+StridePolicy::Tick(Thread *running)
+{
+    if (running->pass > StrideRebase) {
+	int shift = running->pass;
+	if (!ready.IsEmpty() && ready.Min()->pass < shift)
+	    shift = ready.Min()->pass;
+	running->pass -= shift;
+	globalPass = globalPass > shift ? globalPass - shift : 0;
+	for (int i = 0; i < ready.NumItems(); i++)
+	    ready.Item(i)->pass -= shift;
+    }
+    return !ready.IsEmpty() && running->pass > ready.Min()->pass;
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::Charge
+// 	Advance a thread's pass by its stride for each tick it has run.
+//----------------------------------------------------------------------
+
+void
+StridePolicy::Charge(Thread *thread, int ticks)
+{
+    thread->pass += ticks * thread->stride;
+}
+
+//----------------------------------------------------------------------
+// StridePolicy::Print
+// 	Print the ready threads, in heap order.
+//----------------------------------------------------------------------
+
+void
+StridePolicy::Print()
+{
+    printf("(global pass %d)\n", globalPass);
+    for (int i = 0; i < ready.NumItems(); i++)
+	ready.Item(i)->Print();
+}
+
+//----------------------------------------------------------------------
+// LotteryPolicy::Enqueue
+// 	Put a thread on the ready list; where does not matter.
+//----------------------------------------------------------------------
+
+void
+LotteryPolicy::Enqueue(Thread *thread)
+{
+    ready.Append(thread);
+}
+
+//----------------------------------------------------------------------
+// LotteryPolicy::Draw
+// 	Return a ticket number between 0 and "total" - 1.
+//----------------------------------------------------------------------
+
+int
+LotteryPolicy::Draw(int total)
+{
+    return (unsigned) Random() % total;
+}
+
+//----------------------------------------------------------------------
+// LotteryPolicy::PickNext
+// 	Hold a lottery among the ready threads, and take the winner off
+//	the ready list.  Tickets can change while a thread is on the
+//	list (see SC_Share), so they are counted afresh each time.
+//----------------------------------------------------------------------
+
+Thread *
+LotteryPolicy::PickNext()
+{
+    int total = 0;
+
+    for (Thread *t = ready.Front(); t != NULL; t = ThreadQueue::Next(t))
+	total += t->tickets;
+    if (total == 0)
+	return NULL;
+
+    int winner = Draw(total);
+    Thread *prev = NULL;
+    for (Thread *t = ready.Front(); ; prev = t, t = ThreadQueue::Next(t)) {
+	winner -= t->tickets;
+	if (winner < 0)
+	    break;
+    }
+    return ready.RemoveAfter(prev);
+}
+
+//----------------------------------------------------------------------
+// LotteryPolicy::Tick
+// 	Hold a lottery among the running and ready threads: if the
+//	running thread loses, it yields, and PickNext holds another
+//	lottery among the ready threads -- which picks each of them with
+//	the same odds as if it had won this one.
+//----------------------------------------------------------------------
+
+bool
+LotteryPolicy::Tick(Thread *running)
+{
+    if (ready.IsEmpty())
+	return FALSE;
+
+    int total = running->tickets;
+    for (Thread *t = ready.Front(); t != NULL; t = ThreadQueue::Next(t))
+	total += t->tickets;
+    return Draw(total) >= running->tickets;
+}
+
+void
+LotteryPolicy::Print()
+{
+    for (Thread *t = ready.Front(); t != NULL; t = ThreadQueue::Next(t))
+	t->Print();
 }
@@ -1,38 +1,221 @@
-// scheduler.h 
+// scheduler.h
 //	Data structures for the thread dispatcher and scheduler.
 //	Primarily, the list of threads that are ready to run.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
 
-// The following class defines the scheduler/dispatcher abstraction -- 
-// the data structures and operations needed to keep track of which 
+// The following class defines a scheduling policy: which ready thread
+// runs next, and when the running thread is preempted.  The scheduler
+// calls these routines, with interrupts disabled, to keep the ready
+// list; it does the dispatching and the accounting common to all
+// policies itself.
+
+class SchedPolicy {
+  public:
+    SchedPolicy(const char *policyName) { name = policyName; }
+    virtual ~SchedPolicy() {}
+
+    virtual void Enqueue(Thread *thread) = 0;	// A new or woken thread
+						// is ready to run
+    virtual void Yield(Thread *thread) { Enqueue(thread); }
+						// The running thread is
+						// going back to the ready list
+    virtual Thread *PickNext() = 0;		// Take the next thread to
+						// run off the ready list, or
+						// return NULL if there is none
+    virtual bool Tick(Thread *running) = 0;	// Called on each timer
+						// interrupt: TRUE to preempt
+    virtual void Charge(Thread *thread, int ticks) {}
+						// "thread" has run "ticks"
+    virtual bool Preemptive() { return TRUE; }	// Does it need the timer?
+    virtual void Print() = 0;			// Print the ready list
+
+    const char *getName() { return name; }
+
+  private:
+    const char *name;
+};
+
+extern SchedPolicy *NewSchedPolicy(const char *name);	// NULL if unknown
+
+// The following class defines the scheduler/dispatcher abstraction --
+// the data structures and operations needed to keep track of which
 // thread is running, and which threads are ready but not running.
 
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(SchedPolicy *p);		// Initialize list of ready threads
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
-    Thread* FindNextToRun();		// Dequeue first thread on the ready 
+    Thread* FindNextToRun();		// Dequeue first thread on the ready
 					// list, if any, and return thread.
-    int highestPriority();
+    void Tick();			// Called on each timer interrupt;
+					// preempt the running thread?
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void AfterSwitch();
     void Print();			// Print contents of ready list
-    
+
+    SchedPolicy *getPolicy() { return policy; }
+
+    static int Weight(int priority);	// CPU share of a thread at this
+					// priority, relative to the others
+
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    void Charge(Thread* thread);	// Account for the time "thread" has
+					// run since it was last charged
+    void StartClock(Thread* thread);	// ... and count it from now
+
+    SchedPolicy *policy;		// Decides which thread runs next
+};
+
+// Threads run in the order they became ready, each until it blocks
+// or yields.
+
+class FifoPolicy : public SchedPolicy {
+  public:
+    FifoPolicy(const char *policyName = "fifo") : SchedPolicy(policyName) {}
+
+    void Enqueue(Thread *thread);
+    Thread *PickNext();
+    bool Tick(Thread *running) { return FALSE; }
+    bool Preemptive() { return FALSE; }
+    void Print();
+
+  private:
+    ThreadQueue ready;
+};
+
+// Threads run in turn, each for at most RoundRobinQuantum timer
+// interrupts at a time.
+
+#define RoundRobinQuantum	1
+
+class RoundRobinPolicy : public FifoPolicy {
+  public:
+    RoundRobinPolicy() : FifoPolicy("rr") {}
+
+    void Enqueue(Thread *thread);
+    bool Tick(Thread *running);
+    bool Preemptive() { return TRUE; }
+};
+
+// Threads run in priority order, round robin within a priority: a
+// thread runs until a higher priority thread is ready, or until it
+// has used up its time slice (1 << priority timer interrupts) and
+// another thread of its priority is ready.
+
+class PriorityPolicy : public SchedPolicy {
+  public:
+    PriorityPolicy(const char *policyName = "priority");
+
+    void Enqueue(Thread *thread);
+    Thread *PickNext();
+    bool Tick(Thread *running);
+    void Print();
+
+  protected:
+    int highestPriority();		// Of the ready threads
+
+  private:
+    // Threads that are ready to run, but not running: a FIFO queue
+    // for each priority, and a bit for each queue that is not empty.
+    ThreadQueue readyList[MaxPriority + 1];
+    unsigned int readyLevels;
+};
+
+// Multi-level feedback queue: as above, but a thread that uses up its
+// time slice drops a priority level and yields, whether or not another
+// thread of its priority is ready.
+
+class MlfqPolicy : public PriorityPolicy {
+  public:
+    MlfqPolicy() : PriorityPolicy("mlfq") {}
+
+    bool Tick(Thread *running);
+};
+
+// A queue of threads ordered by virtual runtime
+typedef HeapQueue<Thread, &Thread::vruntime, &Thread::schedOrder> ThreadHeap;
+
+// "Completely fair" scheduling: each thread gets a share of the CPU in
+// proportion to its weight (from its priority).  The thread that has
+// run the least, in virtual time -- simulated ticks divided by weight
+// -- runs next, and is preempted once it has run FairGranularity ticks
+// more than the next one in line.
+
+#define FairGranularity	100		// virtual ticks
+#define FairRebase	(1 << 30)	// shift all vruntimes down beyond this
+
+class FairPolicy : public SchedPolicy {
+  public:
+    FairPolicy();
+
+    void Enqueue(Thread *thread);
+    void Yield(Thread *thread);
+    Thread *PickNext();
+    bool Tick(Thread *running);
+    void Print();
+
+  private:
+    ThreadHeap ready;			// Ready threads, least run first
+    int minVruntime;			// Never decreases: where new and
+					// waking threads start from
+};
+
+// A queue of threads ordered by pass
+typedef HeapQueue<Thread, &Thread::pass, &Thread::schedOrder> PassHeap;
+
+// Stride scheduling: each thread gets a share of the CPU in proportion
+// to its tickets, deterministically.  The thread with the lowest pass
+// runs next, and is preempted once its pass is beyond the next one's.
+// A new or woken thread starts at the pass of the last thread picked,
+// so it neither catches up on time it spent asleep nor waits it out.
+
+#define StrideRebase	(1 << 30)	// shift all passes down beyond this
+
+class StridePolicy : public SchedPolicy {
+  public:
+    StridePolicy();
+
+    void Enqueue(Thread *thread);
+    void Yield(Thread *thread);
+    Thread *PickNext();
+    bool Tick(Thread *running);
+    void Charge(Thread *thread, int ticks);
+    void Print();
+
+  private:
+    PassHeap ready;			// Ready threads, lowest pass first
+    int globalPass;			// Pass of the last thread picked
+};
+
+// Lottery scheduling: each thread gets a share of the CPU in
+// proportion to its tickets, on average.  At each timer interrupt, a
+// ticket is drawn from those of the running and ready threads, and the
+// owner runs next.
+
+class LotteryPolicy : public SchedPolicy {
+  public:
+    LotteryPolicy() : SchedPolicy("lottery") {}
+
+    void Enqueue(Thread *thread);
+    Thread *PickNext();
+    bool Tick(Thread *running);
+    void Print();
+
+  private:
+    int Draw(int total);		// Pick a ticket out of "total"
+
+    ThreadQueue ready;
 };
 
 #endif // SCHEDULER_H
@@ -37,7 +37,6 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List;
 }
 
 //----------------------------------------------------------------------
@@ -48,7 +47,6 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 
 Semaphore::~Semaphore()
 {
-    delete queue;
 }
 
 //----------------------------------------------------------------------
@@ -66,7 +64,7 @@ Semaphore::P()
 {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue.Append(currentThread);		// so go to sleep
 	currentThread->Sleep();
     } 
     value--; 					// semaphore available, 
@@ -89,7 +87,7 @@ Semaphore::V()
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
+    thread = queue.Remove();
     if (thread != NULL)	   // make thread ready, consuming the V immediately
 	scheduler->ReadyToRun(thread);
     value++;
@@ -99,12 +97,12 @@ Semaphore::V()
 // Dummy functions -- so we can compile our later assignments 
 // Note -- without a correct implementation of Condition::Wait(), 
 // the test case in the network assignment won't work!
-Lock::Lock(char* debugName): held(NULL), name(debugName), queue(new List){}
-Lock::~Lock() {delete queue;}
+Lock::Lock(char* debugName): name(debugName), held(NULL) {}
+Lock::~Lock() {}
 void Lock::Acquire() {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     while(held != NULL){
-        queue->Append((void *)currentThread);
+        queue.Append(currentThread);
 	    currentThread->Sleep();
     }
     held = currentThread;
@@ -114,7 +112,7 @@ void Lock::Release() {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     ASSERT(isHeldByCurrentThread());
     held = NULL;
-    Thread *thread = (Thread *)queue->Remove();
+    Thread *thread = queue.Remove();
     if(thread != NULL)scheduler->ReadyToRun(thread);
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -122,13 +120,13 @@ bool Lock::isHeldByCurrentThread() {
     return held == currentThread;
 }
 
-Condition::Condition(char* debugName): name(debugName), queue(new List) {}
-Condition::~Condition() {delete queue;}
+Condition::Condition(char* debugName): name(debugName) {}
+Condition::~Condition() {}
 void Condition::Wait(Lock* conditionLock) {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     ASSERT(conditionLock->isHeldByCurrentThread());
     conditionLock->Release();
-    queue->Append((void *)currentThread);
+    queue.Append(currentThread);
     currentThread->Sleep();
     conditionLock->Acquire();
     (void) interrupt->SetLevel(oldLevel);
@@ -136,14 +134,14 @@ void Condition::Wait(Lock* conditionLock) {
 void Condition::Signal(Lock* conditionLock) {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     ASSERT(conditionLock->isHeldByCurrentThread());
-    Thread *thread = (Thread *)queue->Remove();
+    Thread *thread = queue.Remove();
     if(thread != NULL)scheduler->ReadyToRun(thread);
     (void) interrupt->SetLevel(oldLevel);
 }
 void Condition::Broadcast(Lock* conditionLock) {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
     ASSERT(conditionLock->isHeldByCurrentThread());
-    while(!queue->IsEmpty()) scheduler->ReadyToRun((Thread *)queue->Remove());
+    while(!queue.IsEmpty()) scheduler->ReadyToRun(queue.Remove());
     (void) interrupt->SetLevel(oldLevel);
 }
 
@@ -156,7 +154,7 @@ void Barrier::barrier(){
     lock->Release();
 }
 
-ReadWriteLock::ReadWriteLock(char* debugName): name(debugName), lock(new Semaphore(debugName, 1)), mutex(new Lock(debugName)) {}
+ReadWriteLock::ReadWriteLock(char* debugName): name(debugName), lock(new Semaphore(debugName, 1)), mutex(new Lock(debugName)), readers(0) {}
 ReadWriteLock::~ReadWriteLock() {delete lock; delete mutex;}
 void ReadWriteLock::AcquireRead(){
     mutex->Acquire();
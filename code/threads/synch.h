@@ -48,7 +48,7 @@ class Semaphore {
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    ThreadQueue queue; // threads waiting in P() for the value to be > 0
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -81,7 +81,7 @@ class Lock {
     char* name;				// for debugging
     // plus some other stuff you'll need to define
     Thread *held;
-    List *queue;
+    ThreadQueue queue;			// threads waiting
 };
 
 // The following class defines a "condition variable".  A condition
@@ -134,7 +134,7 @@ class Condition {
   private:
     char* name;
     // plus some other stuff you'll need to define
-    List *queue;
+    ThreadQueue queue;			// threads waiting
 };
 
 class Barrier{
@@ -18,16 +18,10 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+int stackPoolMax = 64;			// stacks kept for re-use
 
-int tid_pool[MAX_THREAD], tid_pool_num=0;
-FileHeader* openfile_table[NumSectors];
-
-Thread *thread_list[MAX_THREAD];
-
-int getNextTid() {
-    ASSERT(tid_pool_num>0);
-    return tid_pool[--tid_pool_num];
-}
+ThreadTable *threadTable;		// all threads, by id
+FileHeader** openfile_table;		// indexed by header sector
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -35,6 +29,7 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
@@ -45,10 +40,95 @@ Machine *machine;	// user program memory and registers
 PostOffice *postOffice;
 #endif
 
+volatile bool abortRequested = FALSE;	// set by ctl-C, see UserAbort
 
 // External definition, to allow us to take a pointer to this function
 extern void Cleanup();
 
+#ifdef FILESYS
+//----------------------------------------------------------------------
+// SyncThread
+// 	Write the file system out when Nachos is about to stop, and then
+//	halt if asked to (see SyncBeforeHalt).
+//----------------------------------------------------------------------
+
+static Semaphore *syncWanted;		// wakes the sync thread
+static bool syncing = FALSE;		// it has been woken, and is not done
+static bool haltAfterSync = FALSE;	// halt once it is done
+static int syncedAt = -1;		// busy ticks when it was last done
+
+static void
+SyncThread(int dummy)
+{
+    while (TRUE) {
+	syncWanted->P();
+	fileSystem->Sync();
+	syncedAt = stats->totalTicks - stats->idleTicks;
+	syncing = FALSE;
+	if (haltAfterSync)
+	    interrupt->Halt();
+    }
+}
+#endif
+
+//----------------------------------------------------------------------
+// SyncBeforeHalt
+// 	Called with interrupts disabled when Nachos is about to stop: by
+//	Interrupt::Idle once no thread is left to run, or after ctl-C,
+//	with "halt" set.  The journal commits only every few operations,
+//	and file data is buffered, so whatever was done since the last
+//	FileSystem::Sync would be lost.  Wake the sync thread to write it
+//	out, and return TRUE; if "halt", it halts Nachos when it is done,
+//	otherwise the next Interrupt::Idle will.
+//
+//	Return FALSE if there is no file system, or nothing to write, or
+//	the sync thread is already at it -- or has just been, without
+//	managing to write everything (an operation is stuck halfway), and
+//	nothing has run since.
+//----------------------------------------------------------------------
+
+bool
+SyncBeforeHalt(bool halt)
+{
+#ifdef FILESYS
+    if (halt)
+	haltAfterSync = TRUE;
+    if (syncing)
+	return FALSE;
+    if (!halt && (!fileSystem->NeedsSync()
+		|| syncedAt == stats->totalTicks - stats->idleTicks))
+	return FALSE;
+    syncing = TRUE;
+    syncWanted->V();
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+//----------------------------------------------------------------------
+// UserAbort
+// 	Called when the user hits ctl-C.  With a file system, ask for it
+//	to be written out and Nachos halted, the next time the simulated
+//	machine checks for interrupts -- not here, in the middle of
+//	whatever the kernel was doing.  A second ctl-C stops at once.
+//----------------------------------------------------------------------
+
+static void
+UserAbort()
+{
+#ifdef FILESYS
+    static bool aborting = FALSE;
+
+    if (!aborting) {
+	aborting = TRUE;
+	abortRequested = TRUE;
+	return;
+    }
+#endif
+    Cleanup();
+}
+
 
 //----------------------------------------------------------------------
 // TimerInterruptHandler
@@ -57,9 +137,10 @@ extern void Cleanup();
 //	This routine is called each time there is a timer interrupt,
 //	with interrupts disabled.
 //
+//	The scheduler decides whether to preempt the running thread.
 //	Note that instead of calling Yield() directly (which would
 //	suspend the interrupt handler, not the interrupted thread
-//	which is what we wanted to context switch), we set a flag
+//	which is what we wanted to context switch), it sets a flag
 //	so that once the interrupt handler is done, it will appear as 
 //	if the interrupted thread called Yield at the point it is 
 //	was interrupted.
@@ -68,14 +149,8 @@ extern void Cleanup();
 //		whether it needs it or not.
 //----------------------------------------------------------------------
 static void TimerInterruptHandler(int dummy) {
-    if (interrupt->getStatus() != IdleMode) {
-        if (!currentThread->decreaseTimeSlice()) {
-            interrupt->YieldOnReturn();
-            currentThread->promotePriority(-1);
-        } else if (currentThread->getPriority() > scheduler->highestPriority()){
-            interrupt->YieldOnReturn();
-        }
-    }
+    if (interrupt->getStatus() != IdleMode)
+        scheduler->Tick();
 }
 
 //----------------------------------------------------------------------
@@ -94,12 +169,17 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    char* schedName = NULL;	// scheduling policy
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
+    int blockSize = SectorSize;	// file block size, if formatting
+#endif
+#ifdef FILESYS
+    int tracks = 0, sectors = 0;	// disk geometry, if formatting
 #endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
@@ -121,6 +201,14 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-stacks")) {
+	    ASSERT(argc > 1);
+	    stackPoolMax = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-sched")) {
+	    ASSERT(argc > 1);
+	    schedName = *(argv + 1);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
@@ -129,6 +217,19 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
+	else if (!strcmp(*argv, "-bs")) {
+	    ASSERT(argc > 1);
+	    blockSize = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+#endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-geom")) {
+	    ASSERT(argc > 2);
+	    tracks = atoi(*(argv + 1));
+	    sectors = atoi(*(argv + 2));
+	    argCount = 3;
+	}
 #endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
@@ -146,12 +247,19 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
-    if (randomYield)				// start the timer (if needed)
+    SchedPolicy *policy = NewSchedPolicy(schedName ? schedName : "mlfq");
+    if (policy == NULL) {
+	printf("Unknown scheduling policy \"%s\": "
+	    "try fifo, rr, priority, mlfq, cfs, stride or lottery\n", schedName);
+	Exit(1);
+    }
+    scheduler = new Scheduler(policy);		// initialize the ready queue
+    if (randomYield || (schedName && policy->Preemptive()))
+						// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
 
     threadToBeDestroyed = NULL;
-    for (int i=MAX_THREAD-1;i>=0;i--) tid_pool[tid_pool_num++]=i;
+    threadTable = new ThreadTable();
 
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
@@ -160,18 +268,27 @@ Initialize(int argc, char **argv)
     currentThread->setStatus(RUNNING);
 
     interrupt->Enable();
-    CallOnUserAbort(Cleanup);			// if user hits ctl-C
+    CallOnUserAbort(UserAbort);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    if (!format)			// the geometry is fixed by the format
+	tracks = sectors = 0;
+    synchDisk = new SynchDisk("DISK", tracks, sectors);
+    openfile_table = new FileHeader *[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	openfile_table[i] = NULL;
+    journal = new Journal(format);	// replays the log, if need be
+    syncWanted = new Semaphore("sync wanted", 0);
+    Thread *syncer = new Thread("sync");
+    syncer->Fork(SyncThread, 0);
 #endif
 
 #ifdef FILESYS_NEEDED
-    fileSystem = new FileSystem(format);
+    fileSystem = new FileSystem(format, blockSize);
 #endif
 
 #ifdef NETWORK
@@ -201,6 +318,7 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete journal;
     delete synchDisk;
 #endif
     
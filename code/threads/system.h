@@ -22,6 +22,11 @@ extern void Initialize(int argc, char **argv); 	// Initialization,
 						// called before anything else
 extern void Cleanup();				// Cleanup, called when
 						// Nachos is done.
+extern bool SyncBeforeHalt(bool halt);		// Write the file system out
+						// before Nachos stops; TRUE
+						// if a thread was woken to
+extern volatile bool abortRequested;		// ctl-C was hit: write the
+						// file system out, then halt
 
 extern Thread *currentThread;			// the thread holding the CPU
 extern Thread *threadToBeDestroyed;  		// the thread that just finished
@@ -29,13 +34,12 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern int stackPoolMax;			// stacks of finished threads
+						// kept for new ones (-stacks)
 
-const int MAX_THREAD = 128;
-extern int tid_pool[MAX_THREAD], tid_pool_num;
-extern int getNextTid();
+extern ThreadTable *threadTable;			// all threads, by id
 
-extern Thread *thread_list[MAX_THREAD];
-extern FileHeader* openfile_table[NumSectors];
+extern FileHeader** openfile_table;
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -49,7 +53,9 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "journal.h"
 extern SynchDisk   *synchDisk;
+extern Journal	   *journal;		// metadata journal, on top of synchDisk
 #endif
 
 #ifdef NETWORK
@@ -25,6 +25,9 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+static int *StackGet();			// see below
+static void StackFree(int *stack);
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -40,9 +43,22 @@ Thread::Thread(char* threadName)
     stack = NULL;
     status = JUST_CREATED;
     uid = getuid();
+    priority = 0;
+    resetTimeSlice();
+    queueNext = NULL;
+    vruntime = runTicks = userTicks = systemTicks = 0;
+    runSince = readySince = createdAt = stats->totalTicks;
+    systemSince = stats->systemTicks;
+    idleSince = stats->idleTicks;
+    readyWaitTicks = voluntarySwitches = involuntarySwitches = 0;
+    preempted = FALSE;
+    setTickets(DefaultTickets);
+    pass = 0;
+#ifdef FILESYS
+    journalDepth = 0;
+#endif
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    tid = getNextTid();
-    thread_list[tid] = this;
+    tid = threadTable->Add(this);
     (void) interrupt->SetLevel(oldLevel);
 #ifdef USER_PROGRAM
     space = NULL;
@@ -50,7 +66,6 @@ Thread::Thread(char* threadName)
 }
 
 Thread* newThread(char* threadName){
-    if(tid_pool_num==0) return NULL;
     return new Thread(threadName);
 }
 
@@ -71,10 +86,9 @@ Thread::~Thread()
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
-    if (stack != NULL) DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
-    thread_list[tid] = NULL;
+    if (stack != NULL) StackFree(stack);
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    tid_pool[tid_pool_num++]=tid;
+    threadTable->Remove(tid);
     (void) interrupt->SetLevel(oldLevel);
 #ifdef USER_PROGRAM
     if(space) delete space;
@@ -219,6 +233,20 @@ Thread::Yield ()
     (void) interrupt->SetLevel(oldLevel);
 }
 
+//----------------------------------------------------------------------
+// Thread::Preempt
+// 	Yield, on behalf of an interrupt handler that asked for a context
+//	switch; the switch is counted as involuntary.
+//----------------------------------------------------------------------
+
+void
+Thread::Preempt ()
+{
+    preempted = TRUE;
+    Yield();
+    preempted = FALSE;
+}
+
 //----------------------------------------------------------------------
 // Thread::Sleep
 // 	Relinquish the CPU, because the current thread is blocked
@@ -309,14 +337,165 @@ static void InterruptEnable() { interrupt->Enable();}
 void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 
 void TS(){
-    printf("TID UID %12s NAME\n", "STATUS");
-    for (int i=0;i<MAX_THREAD;i++){
-        Thread *t = thread_list[i];
+    printf("%10s UID %12s %8s %8s %8s %6s %6s NAME\n", "TID", "STATUS",
+           "USER", "SYSTEM", "WAIT", "VOL", "INVOL");
+    for (int i=0;i<threadTable->NumSlots();i++){
+        Thread *t = threadTable->InSlot(i);
         if (!t) continue;
-        printf("%3d %3d %12s \"%s\"\n", t->getTid(), t->getUid(), ThreadStatus2Str[t->getStatus()], t->getName());
+        int wait = t->readyWaitTicks;   // including any wait in progress
+        if (t->getStatus() == READY) wait += stats->totalTicks - t->readySince;
+        printf("%10d %3d %12s %8d %8d %8d %6d %6d \"%s\"\n", t->getTid(),
+               t->getUid(), ThreadStatus2Str[t->getStatus()], t->userTicks,
+               t->systemTicks, wait, t->voluntarySwitches,
+               t->involuntarySwitches, t->getName());
     }
 }
 
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize an empty thread table, with a few free slots.
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    slots = NULL;
+    numSlots = numThreads = 0;
+    firstFree = -1;
+    Grow();
+}
+
+ThreadTable::~ThreadTable()
+{
+    delete [] slots;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Grow
+// 	Double the number of slots, and put the new ones on the free list.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Grow()
+{
+    int size = numSlots > 0 ? numSlots * 2 : 64;
+    Slot *bigger = new Slot[size];
+
+    ASSERT(size <= (1 << TidSlotBits));
+    for (int i = 0; i < numSlots; i++)
+	bigger[i] = slots[i];
+    for (int i = size - 1; i >= numSlots; i--) {	// lowest first
+	bigger[i].thread = NULL;
+	bigger[i].generation = 0;
+	bigger[i].nextFree = firstFree;
+	firstFree = i;
+    }
+    delete [] slots;
+    slots = bigger;
+    numSlots = size;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Add
+// 	Put "thread" in a free slot, and return its thread id.  Call
+//	with interrupts disabled.
+//----------------------------------------------------------------------
+
+int
+ThreadTable::Add(Thread *thread)
+{
+    if (firstFree == -1)
+	Grow();
+
+    int slot = firstFree;
+    firstFree = slots[slot].nextFree;
+    slots[slot].thread = thread;
+    numThreads++;
+    return (slots[slot].generation << TidSlotBits) | slot;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Remove
+// 	Free the slot of thread "tid", and make sure "tid" is not handed
+//	out again for a while.  Call with interrupts disabled.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Remove(int tid)
+{
+    int slot = TidSlot(tid);
+
+    ASSERT(Lookup(tid) != NULL);
+    slots[slot].thread = NULL;
+    slots[slot].generation = (slots[slot].generation + 1)
+	& ((1 << (31 - TidSlotBits)) - 1);	// keep ids positive
+    slots[slot].nextFree = firstFree;
+    firstFree = slot;
+    numThreads--;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Lookup
+// 	Return the thread with id "tid", or NULL if there is none (it
+//	has finished, even if another thread has its slot now).
+//----------------------------------------------------------------------
+
+Thread *
+ThreadTable::Lookup(int tid)
+{
+    int slot = TidSlot(tid);
+
+    if (tid < 0 || slot >= numSlots
+	    || (tid >> TidSlotBits) != slots[slot].generation)
+	return NULL;
+    return slots[slot].thread;
+}
+
+//----------------------------------------------------------------------
+// StackGet, StackFree
+// 	Allocate and free thread execution stacks.  Allocating a stack
+//	goes to the host allocator, and freeing it does too, after two
+//	mprotect calls to unprotect its boundary pages; that adds up when
+//	threads are short-lived, so the stacks of finished threads are
+//	kept on a free list, up to stackPoolMax of them, for new threads
+//	to re-use.  A free stack is linked to the next through its first
+//	word.
+//----------------------------------------------------------------------
+
+static int *stackPool = NULL;		// free stacks
+static int stackPoolSize = 0;		// how many
+
+static int *
+StackGet()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int *stack = stackPool;
+
+    if (stack != NULL) {
+	stackPool = *(int **) stack;
+	stackPoolSize--;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    if (stack == NULL)
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    return stack;
+}
+
+static void
+StackFree(int *stack)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (stackPoolSize < stackPoolMax) {
+	*(int **) stack = stackPool;
+	stackPool = stack;
+	stackPoolSize++;
+	stack = NULL;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    if (stack != NULL)
+	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+}
+
 //----------------------------------------------------------------------
 // Thread::StackAllocate
 //	Allocate and initialize an execution stack.  The stack is
@@ -332,7 +511,7 @@ void TS(){
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    stack = StackGet();
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
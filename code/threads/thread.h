@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "list.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -56,6 +57,18 @@
 #define StackSize	(4 * 1024)	// in words
 
 
+// Priorities run from 0 (the highest) to MaxPriority; a thread at
+// priority p gets a time slice of 2^p ticks.
+#define MaxPriority	30
+
+// A thread's share of the CPU, under the proportional share policies,
+// is its tickets over the total tickets of the threads competing with
+// it.  Under stride scheduling, its pass advances by its stride --
+// StrideLarge / tickets -- for each tick it runs.
+#define DefaultTickets	100
+#define MaxTickets	StrideLarge
+#define StrideLarge	(1 << 16)
+
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED, SUSPENDED };
 
@@ -88,14 +101,44 @@ class Thread {
     int timeSlice;      // time slice
 
   public:
+    Thread *queueNext;  // next thread on the ready list or on the wait
+                        // queue of a semaphore, lock or condition
+
+    // Kept by the scheduler, in simulated ticks
+    int vruntime;       // time run, weighted by priority (see Scheduler::Weight)
+    unsigned schedOrder;// order of arrival on a fair ready list
+    int runTicks;       // time run
+    int userTicks;      //   of which in user programs
+    int systemTicks;    //   and in the kernel
+    int runSince;       // when it started running, or was last charged
+    int systemSince;    // stats->systemTicks and idleTicks then
+    int idleSince;
+    int readyWaitTicks; // time spent on the ready list
+    int voluntarySwitches;   // times it blocked or yielded
+    int involuntarySwitches; // times it was preempted
+    bool preempted;     // being switched out by Preempt
+    int readySince;     // when it was put on the ready list
+    int createdAt;      // when it was created
+
+    int tickets;        // share of the CPU (see DefaultTickets)
+    int stride;         // StrideLarge / tickets
+    int pass;           // time run, in strides, for stride scheduling
+
+#ifdef FILESYS
+    int journalDepth;   // nesting of journal->Begin (see Journal::Begin)
+#endif
+
     int getUid() { return uid; }
     int getTid() { return tid; }
     int getPriority() { return priority; }
-    void setPriority(int prio) { priority = prio > 0 ? prio : 0; }
-    void promotePriority(int num) { priority -= num; if (priority < 0) priority = 0; }
+    void setPriority(int prio) { priority = prio < 0 ? 0 : prio > MaxPriority ? MaxPriority : prio; }
+    void promotePriority(int num) { setPriority(priority - num); }
     void resetTimeSlice() { timeSlice = 1 << priority; }
+    void setTimeSlice(int slice) { timeSlice = slice; }
     int getTimeSlice() { return timeSlice; }
     bool decreaseTimeSlice() { return --timeSlice > 0; }
+    void setTickets(int n) { tickets = n < 1 ? 1 : n > MaxTickets ? MaxTickets : n;
+                             stride = StrideLarge / tickets; }
     Thread(char* debugName);		// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
@@ -107,6 +150,8 @@ class Thread {
     void Fork(VoidFunctionPtr func, int arg); 	// Make thread run (*func)(arg)
     void Yield();  				// Relinquish the CPU if any 
 						// other thread is runnable
+    void Preempt();				// Yield, because of a timer
+						// interrupt
     void Sleep();  				// Put the thread to sleep and 
 						// relinquish the processor
     void Suspend();
@@ -149,6 +194,51 @@ class Thread {
 
 extern Thread* newThread(char* threadName);
 
+// A queue of threads, linked through Thread::queueNext
+typedef IntrusiveList<Thread, &Thread::queueNext> ThreadQueue;
+
+// The following class defines the table of all threads, by thread id.
+// It grows as needed, and its free slots are kept on a list, so that
+// a thread id is allocated and freed in constant time.
+//
+// A thread id is a slot number combined with a generation count for
+// the slot, which goes up each time the slot is re-used: an id kept
+// after its thread has finished does not find whatever thread has
+// taken the slot since.
+
+#define TidSlotBits	20		// up to a million threads at once
+#define TidSlot(tid)	((tid) & ((1 << TidSlotBits) - 1))
+
+class ThreadTable {
+  public:
+    ThreadTable();			// Initialize an empty table
+    ~ThreadTable();
+
+    int Add(Thread *thread);		// Give "thread" a slot; return its id
+    void Remove(int tid);		// Free the slot of thread "tid"
+    Thread *Lookup(int tid);		// The thread with id "tid", or
+					// NULL if it has finished
+
+    int NumSlots() { return numSlots; }	// For walking the table:
+    Thread *InSlot(int slot) { return slots[slot].thread; }
+					// NULL if the slot is free
+    int NumThreads() { return numThreads; }
+
+  private:
+    struct Slot {
+	Thread *thread;			// NULL if free
+	int generation;			// Bumped each time it is re-used
+	int nextFree;			// Next free slot, if free; -1 ends
+    };
+
+    void Grow();			// Double the number of slots
+
+    Slot *slots;
+    int numSlots;
+    int numThreads;			// Slots in use
+    int firstFree;			// -1 if none
+};
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
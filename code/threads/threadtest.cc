@@ -284,6 +284,335 @@ void ReadWriteLockTest(){
     w2->Fork(WriterThread, 5);
 }
 
+//----------------------------------------------------------------------
+// AllocTest
+// 	Check that switching threads does not allocate list elements:
+//	two threads hand a lock and a condition back and forth, and wake
+//	each other through a semaphore, many times over, while the list
+//	elements allocated are counted.  The first few rounds are not counted, since they
+//	may create things that are then re-used.
+//----------------------------------------------------------------------
+
+#define AllocRounds	1000
+#define AllocWarmup	10
+
+static Lock *handoffLock;
+static Condition *handoffCond;
+static Semaphore *handoffDone;
+static int handoffTurn;
+
+void AllocPartner(int rounds){
+    for(int i=0;i<rounds;i++){
+        handoffLock->Acquire();
+        while(handoffTurn!=1) handoffCond->Wait(handoffLock);
+        handoffTurn=0;
+        handoffCond->Signal(handoffLock);
+        handoffLock->Release();
+        handoffDone->V();
+    }
+}
+
+void AllocTest(){
+    DEBUG('t', "Entering AllocTest\n");
+    handoffLock = new Lock("handoff lock");
+    handoffCond = new Condition("handoff condition");
+    handoffDone = new Semaphore("handoff done", 0);
+    handoffTurn = 0;
+    Thread *t = newThread("alloc partner");
+    t->Fork(AllocPartner, AllocWarmup + AllocRounds);
+
+    int before = 0;
+    for(int i=0;i<AllocWarmup + AllocRounds;i++){
+        if(i==AllocWarmup) before = ListElement::numAllocated;
+        handoffLock->Acquire();
+        handoffTurn=1;
+        handoffCond->Signal(handoffLock);
+        while(handoffTurn!=0) handoffCond->Wait(handoffLock);
+        handoffLock->Release();
+        handoffDone->P();
+        currentThread->Yield();
+    }
+    int allocations = ListElement::numAllocated - before;
+    printf("%d rounds of lock handoff, condition wait and semaphore wakeup: "
+           "%d list elements allocated\n", AllocRounds, allocations);
+    ASSERT(allocations == 0);
+}
+
+//----------------------------------------------------------------------
+// TickBenchmark
+// 	Time the simulation of the clock, as seen by user programs: the
+//	host time taken by Interrupt::OneTick for each user instruction,
+//	with the timer (and whatever else) pending as usual.
+//----------------------------------------------------------------------
+
+#define BenchTicks	10000000
+
+void TickBenchmark(){
+    DEBUG('t', "Entering TickBenchmark\n");
+    MachineStatus old = interrupt->getStatus();
+    interrupt->setStatus(UserMode);
+    int ticks = stats->totalTicks;
+    double start = WallTime();
+    for(int i=0;i<BenchTicks;i++) interrupt->OneTick();
+    double elapsed = WallTime() - start;
+    interrupt->setStatus(old);
+    printf("%d user instructions (%d ticks) in %.3f seconds: "
+           "%.1f ns per user instruction\n", BenchTicks,
+           stats->totalTicks - ticks, elapsed, elapsed * 1e9 / BenchTicks);
+}
+
+//----------------------------------------------------------------------
+// SchedWorkload
+// 	A mix of jobs, to compare the scheduling policies (see -sched):
+//	long CPU-bound jobs, interactive jobs that compute briefly between
+//	waits for (simulated) I/O, and short jobs that arrive later on.
+//	Reports throughput, and for each job its turnaround time (arrival
+//	to completion), response time (arrival to first run), and how
+//	long it waited to run again after each I/O.
+//----------------------------------------------------------------------
+
+struct WorkloadJob {
+    char *name;
+    int arrival;		// ticks after the start
+    int bursts;			// number of compute bursts
+    int compute;		// ticks of each burst
+    int io;			// ticks of I/O between bursts
+
+    Semaphore *wakeup;		// filled in as it runs
+    int arrivedAt, readyAt, firstRun, finished;
+    int waits, waitTicks;
+};
+
+static WorkloadJob workload[] = {
+    { "batch 1",	    0,  1, 40000,    0 },
+    { "batch 2",	    0,  1, 40000,    0 },
+    { "batch 3",	 1000,  1, 40000,    0 },
+    { "interactive 1",	    0, 40,   100, 1000 },
+    { "interactive 2",	  500, 40,   100, 1000 },
+    { "interactive 3",	 1500, 40,   100, 1000 },
+    { "short 1",	 5000,  1,  2000,    0 },
+    { "short 2",	10000,  1,  2000,    0 },
+    { "short 3",	20000,  1,  2000,    0 },
+};
+
+#define WorkloadJobs	((int) (sizeof(workload) / sizeof(WorkloadJob)))
+
+static Semaphore *workloadDone;
+
+static void WorkloadWake(int arg){
+    WorkloadJob *job = (WorkloadJob *) arg;
+    job->readyAt = stats->totalTicks;
+    job->wakeup->V();
+}
+
+// Wait "ticks" for something other than the CPU
+static void WorkloadWait(WorkloadJob *job, int ticks){
+    interrupt->Schedule(WorkloadWake, (int) job, ticks, TimerInt);
+    job->wakeup->P();
+}
+
+// Use "ticks" of CPU time, preemptible throughout
+static void WorkloadCompute(int ticks){
+    for(int i=0;i<ticks;i+=SystemTick){
+        interrupt->SetLevel(IntOff);
+        interrupt->SetLevel(IntOn);
+    }
+}
+
+static void WorkloadRun(int arg){
+    WorkloadJob *job = (WorkloadJob *) arg;
+    if(job->arrival > 0) WorkloadWait(job, job->arrival);
+    job->arrivedAt = job->readyAt;
+    job->firstRun = stats->totalTicks;
+    for(int i=0;i<job->bursts;i++){
+        if(i > 0){
+            WorkloadWait(job, job->io);
+            job->waits++;
+            job->waitTicks += stats->totalTicks - job->readyAt;
+        }
+        WorkloadCompute(job->compute);
+    }
+    job->finished = stats->totalTicks;
+    workloadDone->V();
+}
+
+void SchedWorkload(){
+    DEBUG('t', "Entering SchedWorkload\n");
+    workloadDone = new Semaphore("workload done", 0);
+    int start = stats->totalTicks;
+    for(int i=0;i<WorkloadJobs;i++){
+        WorkloadJob *job = &workload[i];
+        job->wakeup = new Semaphore(job->name, 0);
+        job->readyAt = start;
+        job->waits = job->waitTicks = 0;
+        newThread(job->name)->Fork(WorkloadRun, (int) job);
+    }
+    for(int i=0;i<WorkloadJobs;i++) workloadDone->P();
+    int elapsed = stats->totalTicks - start;
+
+    printf("Policy %s: %d jobs in %d ticks, %.3f jobs per 1000 ticks\n",
+           scheduler->getPolicy()->getName(), WorkloadJobs, elapsed,
+           WorkloadJobs * 1000.0 / elapsed);
+    printf("%-14s %8s %10s %8s %8s\n", "JOB", "ARRIVAL", "TURNAROUND",
+           "RESPONSE", "WAKEUP");
+    int turnaround = 0, response = 0;
+    for(int i=0;i<WorkloadJobs;i++){
+        WorkloadJob *job = &workload[i];
+        printf("%-14s %8d %10d %8d", job->name, job->arrivedAt - start,
+               job->finished - job->arrivedAt, job->firstRun - job->arrivedAt);
+        if(job->waits > 0) printf(" %8d", job->waitTicks / job->waits);
+        printf("\n");
+        turnaround += job->finished - job->arrivedAt;
+        response += job->firstRun - job->arrivedAt;
+        delete job->wakeup;
+    }
+    printf("Average turnaround %d, response %d\n",
+           turnaround / WorkloadJobs, response / WorkloadJobs);
+    delete workloadDone;
+}
+
+//----------------------------------------------------------------------
+// ShareTest
+// 	Three CPU-bound threads, with tickets in the ratio 1:2:3, compete
+//	for a while; print the share of the CPU each of them got, by its
+//	own tick accounting.  Under -sched stride or lottery, check that
+//	each share is within StrideError or LotteryError of what its
+//	tickets ask for, relative to that.  Lottery draws some 3000
+//	tickets here, so the smallest share is off by about 4% on
+//	average; the bound is three times that.
+//----------------------------------------------------------------------
+
+#define ShareThreads	3
+#define ShareTicks	300000
+#define StrideError	0.05
+#define LotteryError	0.15
+
+static int shareEnd;
+static int shareTicks[ShareThreads];
+static Semaphore *shareDone;
+
+static void ShareThread(int which){
+    while(stats->totalTicks < shareEnd){
+        interrupt->SetLevel(IntOff);
+        interrupt->SetLevel(IntOn);
+    }
+    shareTicks[which] = currentThread->runTicks;
+    shareDone->V();
+}
+
+void ShareTest(){
+    DEBUG('t', "Entering ShareTest\n");
+    shareDone = new Semaphore("share done", 0);
+    shareEnd = stats->totalTicks + ShareTicks;
+    int tickets = 0;
+    for(int i=0;i<ShareThreads;i++){
+        Thread *t = newThread("share thread");
+        t->setTickets(DefaultTickets * (i + 1));
+        tickets += t->tickets;
+        t->Fork(ShareThread, i);
+    }
+    for(int i=0;i<ShareThreads;i++) shareDone->P();
+
+    int total = 0;
+    for(int i=0;i<ShareThreads;i++) total += shareTicks[i];
+    const char *policy = scheduler->getPolicy()->getName();
+    double bound = 0;
+    if(!strcmp(policy, "stride")) bound = StrideError;
+    else if(!strcmp(policy, "lottery")) bound = LotteryError;
+    printf("Policy %s: %d ticks shared by %d threads\n", policy, total,
+           ShareThreads);
+    for(int i=0;i<ShareThreads;i++){
+        double wanted = (double) DefaultTickets * (i + 1) / tickets;
+        double got = (double) shareTicks[i] / total;
+        double off = (got - wanted) / wanted;
+        printf("thread %d: %d tickets, %5.1f%% of the CPU (wanted %5.1f%%, "
+               "off by %4.1f%%)\n", i, DefaultTickets * (i + 1), got * 100,
+               wanted * 100, off * 100);
+        if(bound > 0) ASSERT(off < bound && off > -bound);
+    }
+    delete shareDone;
+}
+
+//----------------------------------------------------------------------
+// ForkChurn
+// 	Time forking many short-lived threads, and finishing them, on
+//	the host: batches of threads that do nothing but signal that they
+//	ran.  Compare runs with -stacks 0 to see what re-using stacks
+//	saves.
+//----------------------------------------------------------------------
+
+#define ChurnThreads	10000
+#define ChurnBatch	50
+
+static Semaphore *churnDone;
+
+static void ChurnThread(int which){
+    churnDone->V();
+}
+
+void ForkChurn(){
+    DEBUG('t', "Entering ForkChurn\n");
+    churnDone = new Semaphore("churn done", 0);
+    double start = WallTime();
+    for(int i=0;i<ChurnThreads;i+=ChurnBatch){
+        for(int j=0;j<ChurnBatch;j++)
+            newThread("churn thread")->Fork(ChurnThread, i + j);
+        for(int j=0;j<ChurnBatch;j++) churnDone->P();
+    }
+    currentThread->Yield();     // let the last one finish
+    double elapsed = WallTime() - start;
+    printf("%d threads forked and finished in %.3f seconds: %.1f us each "
+           "(%d stacks kept)\n", ChurnThreads, elapsed,
+           elapsed * 1e6 / ChurnThreads, stackPoolMax);
+    delete churnDone;
+}
+
+//----------------------------------------------------------------------
+// ManyThreads
+// 	Have tens of thousands of threads alive at once, all waiting on a
+//	semaphore; then let them finish, and check that the id of one of
+//	them no longer finds a thread, even once its slot is re-used.
+//----------------------------------------------------------------------
+
+#define ManyCount	20000
+
+static Semaphore *manyGate, *manyDone;
+
+static void ManyThread(int which){
+    manyGate->P();
+    manyDone->V();
+}
+
+void ManyThreads(){
+    DEBUG('t', "Entering ManyThreads\n");
+    manyGate = new Semaphore("many gate", 0);
+    manyDone = new Semaphore("many done", 0);
+    int before = threadTable->NumThreads();
+    int tid = -1;
+    for(int i=0;i<ManyCount;i++){
+        Thread *t = newThread("many thread");
+        if(i == 0) tid = t->getTid();
+        t->Fork(ManyThread, i);
+    }
+    currentThread->Yield();
+    printf("%d threads alive, in %d slots\n", threadTable->NumThreads(),
+           threadTable->NumSlots());
+    ASSERT(threadTable->NumThreads() == before + ManyCount);
+    ASSERT(threadTable->Lookup(tid) != NULL);
+
+    for(int i=0;i<ManyCount;i++) manyGate->V();
+    for(int i=0;i<ManyCount;i++) manyDone->P();
+    currentThread->Yield();     // let the last one finish
+    ASSERT(threadTable->Lookup(tid) == NULL);
+
+    Thread *t = newThread("many thread");   // may take the same slot
+    printf("first thread was %d, a new one is %d\n", tid, t->getTid());
+    ASSERT(t->getTid() != tid && threadTable->Lookup(tid) == NULL);
+    delete t;
+    delete manyGate;
+    delete manyDone;
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -311,6 +640,24 @@ ThreadTest()
     case 6:
     ReadWriteLockTest();
     break;
+    case 7:
+    AllocTest();
+    break;
+    case 8:
+    TickBenchmark();
+    break;
+    case 9:
+    SchedWorkload();
+    break;
+    case 10:
+    ShareTest();
+    break;
+    case 11:
+    ForkChurn();
+    break;
+    case 12:
+    ManyThreads();
+    break;
     default:
 	printf("No test specified.\n");
 	break;
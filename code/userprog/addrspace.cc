@@ -154,7 +154,12 @@ AddrSpace::AddrSpace(const AddrSpace* space){
     sprintf(vmname, "VirtualMemory%d", this);
     fileSystem->Create(vmname, size);
     vm = fileSystem->Open(vmname);
-    vm->WriteAt(buffer, size, 0);
+    for (i = 0; i < numPages; i++){     // 全零的页留作空洞，不占磁盘
+        char *page = buffer + i * PageSize;
+        int j = 0;
+        while (j < PageSize && page[j] == 0) j++;
+        if (j < PageSize) vm->WriteAt(page, PageSize, i * PageSize);
+    }
     delete buffer;
     delete vm;
 }
@@ -8,6 +8,7 @@
 
 #include "copyright.h"
 #include "bitmap.h"
+#include "disk.h"
 
 //----------------------------------------------------------------------
 // BitMap::BitMap
@@ -22,8 +23,12 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    dirty = new bool[numWords];
+    for (int i = 0; i < numWords; i++) {
+        map[i] = 0;
+        dirty[i] = TRUE;
+    }
+    firstFree = 0;
 }
 
 //----------------------------------------------------------------------
@@ -34,6 +39,7 @@ BitMap::BitMap(int nitems)
 BitMap::~BitMap()
 { 
     delete map;
+    delete [] dirty;
 }
 
 //----------------------------------------------------------------------
@@ -48,6 +54,7 @@ BitMap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    dirty[which / BitsInWord] = TRUE;
 }
     
 //----------------------------------------------------------------------
@@ -62,6 +69,9 @@ BitMap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    dirty[which / BitsInWord] = TRUE;
+    if (which / BitsInWord < firstFree)
+	firstFree = which / BitsInWord;
 }
 
 //----------------------------------------------------------------------
@@ -89,16 +99,59 @@ BitMap::Test(int which)
 //	(In other words, find and allocate a bit.)
 //
 //	If no bits are clear, return -1.
+//
+//	Whole words with every bit set are skipped, starting from the
+//	first word that may have a clear bit, so that a large, mostly
+//	full bitmap does not cost a test per bit.
 //----------------------------------------------------------------------
 
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
+    for (int w = firstFree; w < numWords; w++) {
+	if (map[w] == ~0u) {
+	    if (w == firstFree)
+		firstFree = w + 1;	// every word before w+1 is full
+	    continue;
+	}
+	for (int i = w * BitsInWord; i < (w + 1) * BitsInWord && i < numBits; i++)
+	    if (!Test(i)) {
+		Mark(i);
+		return i;
+	    }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Return the number of the first of "count" clear bits in a row,
+//	starting at a multiple of "count", and set them all.  Used to
+//	allocate file system blocks made up of several disk sectors.
+//
+//	If there is no such run, return -1.
+//----------------------------------------------------------------------
+
+int 
+BitMap::FindRun(int count) 
+{
+    int i = divRoundUp(firstFree * BitsInWord, count) * count;
+
+    while (i + count <= numBits) {
+	if (map[i / BitsInWord] == ~0u) {	// skip the rest of a full word
+	    i = divRoundUp((i / BitsInWord + 1) * BitsInWord, count) * count;
+	    continue;
+	}
+	int j = 0;
+	while (j < count && !Test(i + j))
+	    j++;
+	if (j == count) {
+	    for (j = 0; j < count; j++)
+		Mark(i + j);
 	    return i;
 	}
+	i += count;
+    }
     return -1;
 }
 
@@ -113,8 +166,17 @@ BitMap::NumClear()
 {
     int count = 0;
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
+    for (int w = 0; w < numWords; w++) {
+	unsigned int set = map[w];
+	int bits = BitsInWord;
+	if ((w + 1) * BitsInWord > numBits) {	// partial last word
+	    bits = numBits - w * BitsInWord;
+	    set &= (1u << bits) - 1;
+	}
+	for (; set != 0; set &= set - 1)	// one pass per set bit
+	    bits--;
+	count += bits;
+    }
     return count;
 }
 
@@ -149,6 +211,9 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    for (int i = 0; i < numWords; i++)
+	dirty[i] = FALSE;
+    firstFree = 0;
 }
 
 //----------------------------------------------------------------------
@@ -162,4 +227,50 @@ void
 BitMap::WriteBack(OpenFile *file)
 {
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+   for (int i = 0; i < numWords; i++)
+	dirty[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// BitMap::IsDirty
+// 	Return TRUE if any word changed since the bitmap was last read
+//	or written.
+//----------------------------------------------------------------------
+
+bool
+BitMap::IsDirty()
+{
+    for (int i = 0; i < numWords; i++)
+	if (dirty[i])
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// BitMap::WriteDirty
+// 	Store the parts of a bitmap that changed to a Nachos file.  The
+//	bitmap is written a sector's worth of words at a time, and only
+//	the sectors holding a changed word are written.
+//
+//	"file" is the place to write the bitmap to
+//----------------------------------------------------------------------
+
+void
+BitMap::WriteDirty(OpenFile *file)
+{
+    int wordsPerSector = SectorSize / sizeof(unsigned);
+
+    for (int first = 0; first < numWords; first += wordsPerSector) {
+	int last = min(first + wordsPerSector, numWords);
+	bool changed = FALSE;
+
+	for (int i = first; i < last; i++) {
+	    if (dirty[i])
+		changed = TRUE;
+	    dirty[i] = FALSE;
+	}
+	if (changed)
+	    file->WriteAt((char *)&map[first], (last - first) * sizeof(unsigned),
+				first * sizeof(unsigned));
+    }
 }
@@ -43,6 +43,9 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int count);	// Like Find, but for "count" clear bits
+				// in a row, starting at a multiple of
+				// "count"
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -51,6 +54,10 @@ class BitMap {
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
     void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteDirty(OpenFile *file);	// write to disk only the sectors
+					// holding bits changed since the
+					// last FetchFrom/WriteBack
+    bool IsDirty();			// Would WriteDirty write anything?
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -59,6 +66,10 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    bool *dirty;			// which words changed since the last
+					// FetchFrom/WriteBack/WriteDirty
+    int firstFree;			// no word before this one has a
+					// clear bit
 };
 
 #endif // BITMAP_H
@@ -144,6 +144,9 @@ ExceptionHandler(ExceptionType which)
     if (which == SyscallException) {
         if(type == SC_Halt){
             DEBUG('T', "Shutdown, initiated by user program.\n");
+#ifdef FILESYS_NEEDED
+            fileSystem->Sync();
+#endif
             interrupt->Halt();
         } else if(type == SC_Exit){
             DEBUG('T', "Exit with code %d.\n", machine->ReadRegister(4));
@@ -167,6 +170,19 @@ ExceptionHandler(ExceptionType which)
             space->lock->Acquire();
             space->condition->Wait(space->lock);
             space->lock->Release();
+        } else if(type == SC_Share){
+            AddrSpace *space = (AddrSpace*)machine->ReadRegister(4);
+            int tickets = machine->ReadRegister(5);
+            if(space == NULL) space = currentThread->space;
+            int n = 0;
+            for(int i=0;i<threadTable->NumSlots();i++){
+                Thread *t = threadTable->InSlot(i);
+                if(t != NULL && t->space == space){
+                    t->setTickets(tickets);
+                    n++;
+                }
+            }
+            machine->WriteRegister(2, n);
         } else if(type == SC_Create){
             int name_addr = machine->ReadRegister(4);
             char *name = new char[FileNameMaxLen + 4];
@@ -216,6 +232,7 @@ ExceptionHandler(ExceptionType which)
             AddrSpace *space = new AddrSpace(currentThread->space);
             Thread *t = new Thread("forked thread");
             t->space = space;
+            t->setTickets(currentThread->tickets);     // 继承份额
             t->Fork(ForkThread, func_addr);
         } else if(type == SC_Yield){
             currentThread->Yield();
@@ -255,6 +272,13 @@ ExceptionHandler(ExceptionType which)
                 if(name[n] == 0)break;
             }
             fileSystem->Remove(name);
+        } else if(type == SC_Pipe){
+            int fds_addr = machine->ReadRegister(4);
+            PipeBuffer *pipe = new PipeBuffer("user pipe");
+            OpenFile *in = new OpenFile(pipe, FALSE);
+            OpenFile *out = new OpenFile(pipe, TRUE);
+            while(!machine->WriteMem(fds_addr, 4, (OpenFileId) in));
+            while(!machine->WriteMem(fds_addr + 4, 4, (OpenFileId) out));
         }
         int nextPC = machine->ReadRegister(NextPCReg);
         machine->WriteRegister(PCReg, nextPC);
@@ -35,6 +35,8 @@
 #define SC_Mkdir    14
 #define SC_Rmdir    15
 #define SC_Remove   16
+#define SC_Pipe     17
+#define SC_Share    18
 
 #ifndef IN_ASM
 
@@ -69,6 +71,18 @@ SpaceId Exec(char *name);
  * Return the exit status.
  */
 int Join(SpaceId id); 	
+
+/* Give every thread of the user program "id" (0 for the calling
+ * program) "tickets" shares of the CPU, under the proportional share
+ * scheduling policies (nachos -sched stride or lottery); by default a
+ * thread has 100.  Return the number of threads changed.
+ *
+ * Threads are matched by address space, and Fork gives the new thread
+ * a copy of the caller's, so a forked thread counts as a program of
+ * its own: only the thread that Exec returned "id" for is changed,
+ * and 0 changes only the caller.
+ */
+int Share(SpaceId id, int tickets);
  
 
 /* File system operations: Create, Open, Read, Write, Close
@@ -114,6 +128,14 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Create a pipe, and store an "OpenFileId" for each end of it in "fds":
+ * fds[0] is the end to Read from, fds[1] the end to Write to.  Read
+ * waits until there is something in the pipe, and returns 0 once it is
+ * empty and the write end has been closed; Write waits while the pipe
+ * is full.  The bytes are buffered in kernel memory.
+ */
+void Pipe(OpenFileId *fds);
+
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple